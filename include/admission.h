@@ -0,0 +1,65 @@
+#ifndef _ADMISSION_H_
+#define _ADMISSION_H_
+
+#include <stdbool.h>
+#include <time.h>
+
+// Initial number of entries in the admission queue (doubled as it fills up)
+#define ADMISSION_QUEUE_MIN 16
+
+// The word prefix that sets a background job's admission priority: `@prio=N cmd &`
+#define PRIORITY_OPTION "@prio="
+
+// A background job waiting for a slot in the job table. It has not been forked yet.
+typedef struct queued_job {
+    char *cmd_line;             // The job as typed, without the `&`
+    int priority;               // Higher priorities are admitted first
+    unsigned long seq;          // Arrival order, for FIFO admission among equal priorities
+    struct timespec queued_at;  // When the job was queued (CLOCK_MONOTONIC)
+} queued_job_t;
+
+// Background jobs held back while the job table is full, as a binary heap in admission order
+typedef struct admission_queue {
+    queued_job_t *heap;         // heap[0] is admitted next
+    int count;                  // The number of queued jobs
+    int capacity;               // The number of entries allocated
+    unsigned long next_seq;     // The seq of the next job queued
+} admission_queue_t;
+
+/*
+ * alloc_admission_queue: Allocates an empty admission queue.
+ *
+ * Returns: a pointer to the allocated queue or NULL on failure.
+ */
+admission_queue_t *alloc_admission_queue(void);
+
+/*
+ * enqueue_job: Queues a background job until the job table has room for it.
+ *
+ * cmd_line: The job's text; the queue keeps a copy.
+ * priority: The job's priority; jobs of equal priority are admitted in the order they were queued.
+ *
+ * Returns: true on success, false if memory could not be allocated.
+ */
+bool enqueue_job(admission_queue_t *queue, const char *cmd_line, int priority);
+
+/*
+ * dequeue_job: Removes the job that is next in admission order.
+ *
+ * Returns: the job's text (which the caller must free), or NULL if the queue is empty.
+ */
+char *dequeue_job(admission_queue_t *queue);
+
+/*
+ * sort_queued_jobs: Lists the queued jobs in admission order without removing them.
+ *
+ * order: An array of at least queue->count entries, filled with pointers into the queue.
+ */
+void sort_queued_jobs(const admission_queue_t *queue, const queued_job_t **order);
+
+/*
+ * free_admission_queue: Frees the queue and the jobs still in it.
+ */
+void free_admission_queue(admission_queue_t *queue);
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef _AFFINITY_H_
+#define _AFFINITY_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// The word prefix that pins a job to a set of CPUs: `@cpus=0-7 cmd &`
+#define CPUS_OPTION "@cpus="
+
+// Number of CPUs a CPU mask can hold (as many as glibc's cpu_set_t)
+#define AFFINITY_MAX_CPUS 1024
+
+// Directory of the NUMA nodes, each with a cpulist file (nodeN/cpulist)
+#define NUMA_NODE_DIR "/sys/devices/system/node"
+
+// A set of CPUs; bit i of the words stands for CPU i
+typedef struct cpu_mask {
+    uint64_t words[AFFINITY_MAX_CPUS / 64];
+} cpu_mask_t;
+
+// How background jobs without @cpus= are placed (msh -A)
+typedef enum affinity_policy {
+    AFFINITY_NONE,          // Wherever the scheduler puts them
+    AFFINITY_RR,            // Each stage on its own CPU, the least used by other pinned jobs first
+    AFFINITY_NUMA,          // The whole job on the NUMA node with the fewest pinned jobs
+} affinity_policy_t;
+
+struct job_table;
+
+/*
+ * parse_cpu_list: Reads a CPU list such as "0-7,16,18-19" (the format of taskset -c and sysfs).
+ *
+ * Returns: true if the list is valid and names at least one CPU below AFFINITY_MAX_CPUS.
+ */
+bool parse_cpu_list(const char *list, cpu_mask_t *mask);
+
+/*
+ * format_cpu_list: Writes mask as a CPU list ("0-7,16") into buf, truncated to size.
+ */
+void format_cpu_list(const cpu_mask_t *mask, char *buf, size_t size);
+
+/*
+ * parse_affinity_policy: Reads a placement policy name: "rr" or "numa" (or "none").
+ *
+ * Returns: true if the name is known.
+ */
+bool parse_affinity_policy(const char *name, affinity_policy_t *policy);
+
+/*
+ * get_cpu_mask: Reads the CPUs process pid (0 for the shell) may run on.
+ *
+ * Returns: true on success.
+ */
+bool get_cpu_mask(pid_t pid, cpu_mask_t *mask);
+
+/*
+ * set_cpu_mask: Restricts process pid (0 for the caller) to the CPUs of mask.
+ *
+ * Returns: 0 on success; otherwise -1 with errno set.
+ */
+int set_cpu_mask(pid_t pid, const cpu_mask_t *mask);
+
+/*
+ * usable_cpus: Drops the CPUs of mask that the shell may not use (and so neither may its jobs).
+ *
+ * Returns: true if any CPU is left.
+ */
+bool usable_cpus(cpu_mask_t *mask);
+
+/*
+ * nth_cpu: Sets one to the n-th CPU of mask, counting from 0 and wrapping around when n is past the
+ * last one. A job placed by AFFINITY_RR runs stage n on nth_cpu(mask, n).
+ */
+void nth_cpu(const cpu_mask_t *mask, int n, cpu_mask_t *one);
+
+/*
+ * place_job: Picks the CPUs of a new background job under a placement policy, spreading jobs over the
+ * CPUs the shell may use according to where the jobs in the table are pinned already.
+ *
+ * nprocs: The number of processes of the job (AFFINITY_RR picks that many CPUs where there are enough,
+ *         one for each process; see nth_cpu).
+ *
+ * Returns: true if mask was set; false for AFFINITY_NONE.
+ */
+bool place_job(affinity_policy_t policy, const struct job_table *jobs, int nprocs, cpu_mask_t *mask);
+
+#endif
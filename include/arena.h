@@ -0,0 +1,56 @@
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <stddef.h>
+
+// Size of an arena's first chunk, which is kept across resets; larger requests get chunks of their own
+#define ARENA_CHUNK_SIZE 8192
+
+typedef struct arena_chunk {
+    struct arena_chunk *next;   // The chunk allocated before this one
+    size_t size;                // Bytes of data in this chunk
+    char data[];                // The memory handed out
+} arena_chunk_t;
+
+// A bump allocator: memory is carved from chunks in order and released all at once by arena_reset
+typedef struct arena {
+    arena_chunk_t *chunks;      // The newest chunk (the first chunk is at the end of the list)
+    char *ptr;                  // The next free byte of the newest chunk
+    char *end;                  // The end of the newest chunk
+} arena_t;
+
+/*
+ * alloc_arena: Allocates an empty arena with one chunk of ARENA_CHUNK_SIZE bytes.
+ *
+ * Returns: a pointer to the arena or NULL on failure.
+ */
+arena_t *alloc_arena(void);
+
+/*
+ * arena_alloc: Allocates size bytes aligned for any type. The memory is valid until the next arena_reset.
+ *
+ * Returns: a pointer to the memory, or NULL if a new chunk could not be allocated.
+ */
+void *arena_alloc(arena_t *arena, size_t size);
+
+/*
+ * arena_strndup: Copies at most len bytes of s into the arena and NUL-terminates the copy.
+ */
+char *arena_strndup(arena_t *arena, const char *s, size_t len);
+
+/*
+ * arena_strdup: Copies s into the arena.
+ */
+char *arena_strdup(arena_t *arena, const char *s);
+
+/*
+ * arena_reset: Releases everything allocated from the arena. The first chunk is kept for reuse.
+ */
+void arena_reset(arena_t *arena);
+
+/*
+ * free_arena: Frees the arena and all of its chunks.
+ */
+void free_arena(arena_t *arena);
+
+#endif
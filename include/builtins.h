@@ -0,0 +1,60 @@
+#ifndef _BUILTINS_H_
+#define _BUILTINS_H_
+
+// Number of slots in the builtin hash table (a power of two, comfortably above the number of builtins)
+#define BUILTIN_SLOTS 64
+
+// The hash seed under which no two builtins share a slot (see hash_builtin_name)
+#define BUILTIN_SEED 17
+
+// Flags of a builtin
+#define BUILTIN_IN_PIPELINE 0x1   // May run as a forked pipeline stage (it does not change the shell itself)
+#define BUILTIN_UTILITY     0x2   // Stands in for an external program, which `command NAME` runs instead
+
+/*
+ * builtin_handler_t: Runs a built-in command inside the shell.
+ *
+ * Returns: the command line to run next (history expansion), or NULL. See builtin_cmd.
+ */
+typedef char *builtin_handler_t(int argc, char **argv);
+
+// An entry of the builtin registry
+typedef struct builtin {
+    const char *name;             // The command name; "!" stands for every !N, !prefix and !?text
+    builtin_handler_t *handler;   // Runs the command
+    unsigned int flags;           // BUILTIN_* flags
+} builtin_t;
+
+/*
+ * find_builtin: Looks up a command name in the builtin registry.
+ *
+ * name: The command name (argv[0]).
+ *
+ * Returns: the registry entry, or NULL if the command is not a built-in command.
+ *
+ * Note: The lookup is a perfect hash: one hash of the name and at most one string comparison, against
+ * a table of slots fixed at compile time.
+ */
+const builtin_t *find_builtin(const char *name);
+
+/*
+ * hash_builtin_name: Hashes a command name to a slot of the builtin table (FNV-1a, below BUILTIN_SLOTS).
+ *
+ * seed: BUILTIN_SEED for the lookup; tests/test_builtins tries others when the registry changes.
+ */
+unsigned int hash_builtin_name(const char *name, unsigned int seed);
+
+/*
+ * builtin_registry: The whole builtin registry, in order (the builtin table holds an index + 1 per slot).
+ *
+ * Returns: the entries; *count is set to their number.
+ */
+const builtin_t *builtin_registry(int *count);
+
+/*
+ * builtin_status: The exit status set by the last built-in command that has one (0 for success). A
+ * builtin run as a pipeline stage exits with it.
+ */
+extern int builtin_status;
+
+#endif
@@ -1,13 +1,32 @@
 #ifndef _HISTORY_H_
 #define _HISTORY_H_
 
+#include <sys/types.h>
+#include <stdbool.h>
+#include "history_index.h"
+
 extern const char *HISTORY_FILE_PATH;
 
+// Number of appended lines between two fsyncs of the history journal
+#define HISTORY_FSYNC_BATCH 32
+
+// The journal is compacted once it is this many times larger than the lines it still holds...
+#define HISTORY_COMPACT_FACTOR 2
+// ...and at least this many bytes
+#define HISTORY_COMPACT_MIN_BYTES (64 * 1024)
+
 
 typedef struct history {
-    char **lines;      // Array of command lines
+    char **lines;      // Circular buffer of command lines
     int max_history;   // Maximum number of history lines
-    int next;          // Next available slot in the history
+    int start;         // Slot of the oldest line (history number 1)
+    int count;         // Number of lines currently in the history
+    int fd;            // Append-only journal (HISTORY_FILE_PATH), or -1 if it could not be opened
+    off_t file_size;   // Bytes currently in the journal
+    off_t live_size;   // Bytes of the journal that belong to lines still in the history
+    int unsynced;      // Lines appended since the last fsync
+    unsigned int next_seq;   // Sequence number of the next line added (the oldest line is next_seq - count)
+    history_index_t *index;  // Trigram index used by search_history
 } history_t;
 
 
@@ -15,6 +34,7 @@ history_t *alloc_history(int max_history);
 void add_line_history(history_t *history, const char *cmd_line);
 void print_history(history_t *history);
 char *find_line_history(history_t *history, int index);
+int search_history(history_t *history, const char *text, bool prefix, int *matches, int max_matches);
 void free_history(history_t *history);
 
 #endif // _HISTORY_H_
@@ -0,0 +1,71 @@
+#ifndef _HISTORY_INDEX_H_
+#define _HISTORY_INDEX_H_
+
+#include <stdbool.h>
+
+// Initial number of slots in the trigram table (a power of two, doubled as it fills up)
+#define HISTORY_INDEX_SLOTS 1024
+
+// Sentinels put in front of every indexed line so that prefixes have trigrams of their own
+#define HISTORY_INDEX_PAD "\x01\x01"
+
+// The posting list of one trigram: the sequence numbers of the lines that contain it, oldest first
+typedef struct posting_list {
+    unsigned int gram;    // The trigram packed into 24 bits (0 marks an empty slot)
+    unsigned int *seqs;   // Sequence numbers in ascending order
+    unsigned int len;     // Number of entries used in seqs
+    unsigned int cap;     // Number of entries allocated in seqs
+} posting_list_t;
+
+// Inverted trigram index over the history, maintained incrementally as lines are added and evicted
+typedef struct history_index {
+    posting_list_t *slots;        // Open-addressing table of posting lists
+    unsigned int num_slots;       // Number of slots (a power of two)
+    unsigned int used;            // Number of slots holding a trigram
+    unsigned long live_postings;  // Entries that belong to lines still in the history
+    unsigned long stale_postings; // Entries that belong to evicted lines
+} history_index_t;
+
+/*
+ * alloc_history_index: Allocates an empty trigram index.
+ *
+ * Returns: a pointer to the allocated index or NULL on failure.
+ */
+history_index_t *alloc_history_index(void);
+
+/*
+ * index_history_line: Adds every trigram of a history line to the index.
+ *
+ * seq: The line's sequence number; it must be larger than that of every line indexed before.
+ */
+void index_history_line(history_index_t *index, const char *line, unsigned int seq);
+
+/*
+ * unindex_history_line: Records that a line left the history. Its entries are dropped lazily and swept
+ * once stale entries outnumber live ones.
+ *
+ * oldest_seq: The sequence number of the oldest line still in the history.
+ */
+void unindex_history_line(history_index_t *index, const char *line, unsigned int oldest_seq);
+
+/*
+ * history_index_candidates: Finds the shortest posting list among the trigrams of a query.
+ *
+ * text: The query string.
+ * prefix: true if the query must match at the start of a line.
+ * candidates: Stores the posting list at this address; NULL if a trigram of the query never occurs
+ *             (so nothing can match).
+ *
+ * Returns: false if the query is too short to use the index (the caller must scan linearly);
+ * otherwise true. Every line containing the query is in the candidate list, but candidates still need
+ * to be verified against the query.
+ */
+bool history_index_candidates(history_index_t *index, const char *text, bool prefix,
+                              const posting_list_t **candidates);
+
+/*
+ * free_history_index: Frees the index and all posting lists.
+ */
+void free_history_index(history_index_t *index);
+
+#endif
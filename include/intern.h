@@ -0,0 +1,33 @@
+#ifndef _INTERN_H_
+#define _INTERN_H_
+
+#include <stddef.h>
+
+// Initial number of buckets in the string pool (doubled as it fills up)
+#define INTERN_BUCKETS 256
+
+/*
+ * intern_string: Returns the pooled copy of s, adding it to the pool if needed. Long-lived strings that
+ * repeat (history lines, the command lines of jobs) are stored once however many times they are kept.
+ *
+ * Returns: the pooled string, or NULL on failure. It must not be modified; give it back with
+ * release_string.
+ */
+char *intern_string(const char *s);
+
+/*
+ * intern_string_len: Like intern_string, for the first len bytes of s (which need not be NUL-terminated).
+ */
+char *intern_string_len(const char *s, size_t len);
+
+/*
+ * release_string: Drops one reference to a pooled string; the last reference frees it.
+ */
+void release_string(char *s);
+
+/*
+ * intern_stats: Reports the number of distinct strings in the pool and the references held to them.
+ */
+void intern_stats(size_t *strings, size_t *references);
+
+#endif
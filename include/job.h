@@ -3,27 +3,125 @@
 
 #include <sys/types.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/resource.h> // For struct rusage
+#include "affinity.h"   // For cpu_mask_t
+
+// Environment variable that lets the job table grow past -j instead of refusing new jobs
+#define JOBS_GROW_ENV "MSH_GROW_JOBS"
+
+// Number of finished jobs whose accounting is kept for `jobs -v` and `time`
+#define JOBS_FINISHED_KEEP 16
 
 typedef enum job_state { FOREGROUND, BACKGROUND, SUSPENDED, UNDEFINED } job_state_t;
 
+// Resource accounting of a job, collected with wait4 as its processes are reaped
+typedef struct job_usage {
+    struct timespec start;  // When the job was launched (CLOCK_MONOTONIC)
+    struct timespec end;    // When its last process was reaped (zero while it runs)
+    int status;             // Wait status of the job's last stage, once reaped
+    struct rusage rusage;   // CPU time, context switches and faults summed, max RSS maxed, over reaped processes
+} job_usage_t;
+
 typedef struct job {
     char *cmd_line;     // The command line for this specific job.
     job_state_t state;  // The current state for this job
-    pid_t pid;          // The process id for this job
+    pid_t pid;          // The process group id for this job (pid of its first process)
     int jid;            // The job number for this job
+    pid_t *procs;       // The pids of every process in the job (one per pipeline stage)
+    int *pidfds;        // A pidfd for each process in procs, -1 once reaped or if pidfds are unavailable
+    int nprocs;         // The number of processes in procs
+    int nlive;          // The number of processes that have not been reaped yet
+    job_usage_t usage;  // Timing and resource usage of the job
+    bool silent;        // Finishes without a completion notice (set for parallel's runs)
+    bool pinned;        // The job was started restricted to cpus (@cpus= or msh -A)
+    cpu_mask_t cpus;    // The CPUs the job may run on, if pinned
 } job_t;
 
-job_t *get_job_by_pid(job_t *jobs, int max_jobs, pid_t pid);
-job_t *get_foreground_job(job_t *jobs, int max_jobs);
+// A job that has finished, kept for its accounting
+typedef struct finished_job {
+    char *cmd_line;     // The command line of the job
+    pid_t pid;          // The process group id the job had
+    int jid;            // The job number the job had
+    job_usage_t usage;  // Timing and resource usage of the job
+} finished_job_t;
+
+// A background job that finished and has not been reported at a prompt yet
+typedef struct completion {
+    char *cmd_line;     // The command line of the job (the notice holds its own reference)
+    pid_t pid;          // The process group id the job had
+    int jid;            // The job number the job had
+} completion_t;
+
+// Maps a pid to the slot of the job that owns it (open addressing, linear probing)
+typedef struct pid_slot {
+    pid_t pid;          // The pid (0 marks an empty entry)
+    int slot;           // The slot of the job in the job table
+} pid_slot_t;
+
+typedef struct job_table {
+    job_t *jobs;        // The job slots; a job's jid is its slot + 1
+    int capacity;       // The number of slots allocated
+    int max_jobs;       // The number of slots allowed by -j
+    bool grow;          // true if the table may grow past max_jobs
+    int count;          // The number of slots in use
+    uint64_t *used;     // Bitmap of slots in use, for finding the lowest free jid
+    int fg_slot;        // The slot of the foreground job, or -1 if there is none
+    pid_slot_t *pids;   // Index of every job's pgid and live process pids
+    int pid_capacity;   // The number of entries in pids (a power of two)
+    int pid_count;      // The number of entries of pids in use
+    finished_job_t finished[JOBS_FINISHED_KEEP]; // The most recently finished jobs, a ring
+    unsigned long num_finished; // The number of jobs that have ever finished
+    bool notify;        // true if background jobs that finish are queued in completions
+    completion_t *completions; // Finished background jobs not reported yet, oldest first
+    int num_completions; // The number of entries of completions in use
+    int completions_capacity; // The number of entries allocated
+} job_table_t;
+
+// allocates an empty job table with max_jobs slots
+job_table_t *alloc_jobs(int max_jobs, bool grow);
+
+// finds the job whose process group is pid or that owns the live process pid, in O(1)
+job_t *get_job_by_pid(job_table_t *table, pid_t pid);
+
+// finds the job with the given job number, in O(1)
+job_t *get_job_by_jid(job_table_t *table, int jid);
 
-// adds job to job list
-bool add_job(job_t *jobs, int max_jobs, pid_t pid, job_state_t state, const char *cmd_line);
+// returns the foreground job (cached, O(1)), or NULL if there is none
+job_t *get_foreground_job(job_table_t *table);
+
+// changes a job's state, keeping the foreground job cache up to date
+void set_job_state(job_table_t *table, job_t *job, job_state_t state);
+
+// returns true if every slot is in use and the table may not grow
+bool job_table_full(const job_table_t *table);
+
+// adds job to job list; pgid is the job's process group and procs its nprocs processes. Returns false,
+// adding nothing, if the table is full or memory runs out (including for the interned cmd_line)
+bool add_job(job_table_t *table, pid_t pgid, const pid_t *procs, int nprocs,
+             job_state_t state, const char *cmd_line);
 
 // deletes job from job list
-bool delete_job(job_t *jobs, int max_jobs, pid_t pid); // updated with max_jobs
+bool delete_job(job_table_t *table, pid_t pid);
+
+// records that process pid of job was reaped with the given wait status and resource usage (from
+// wait4); returns true once every process of the job is gone
+bool job_process_exited(job_table_t *table, job_t *job, pid_t pid, int status, const struct rusage *rusage);
+
+// empties the completion queue once its notices have been printed
+void clear_completions(job_table_t *table);
+
+// returns the pidfd of live process pid of job, or -1 if it has been reaped or has no pidfd
+int job_pidfd(const job_t *job, pid_t pid);
+
+// finds the accounting of the most recent finished job with process group pid, or NULL if it is not kept
+const finished_job_t *get_finished_job(const job_table_t *table, pid_t pid);
+
+// seconds from start to end, or from start to now if end is zero
+double elapsed_seconds(const struct timespec *start, const struct timespec *end);
 
 // frees memory allocated for jobs
-void free_jobs(job_t *jobs, int max_jobs);
+void free_jobs(job_table_t *table);
 
 #endif
-
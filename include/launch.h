@@ -0,0 +1,71 @@
+#ifndef _LAUNCH_H_
+#define _LAUNCH_H_
+
+#include <sys/types.h>
+#include <signal.h>
+#include <stdbool.h>
+#include "affinity.h"   // For cpu_mask_t
+#include "priority.h"   // For bg_policy_t
+
+// Environment variable that selects the launch backend ("fork", "spawn" or "zygote")
+#define LAUNCH_BACKEND_ENV "MSH_LAUNCH"
+
+// Largest launch request (argv, environment and working directory) sent to the zygote; larger ones fork
+#define ZYGOTE_MAX_REQUEST 65536
+
+typedef enum launch_backend { LAUNCH_FORK, LAUNCH_SPAWN, LAUNCH_ZYGOTE } launch_backend_t;
+
+/*
+ * launch_backend_from_env: Reads the launch backend from the MSH_LAUNCH environment variable.
+ *
+ * Returns: LAUNCH_FORK if MSH_LAUNCH is "fork", LAUNCH_ZYGOTE if it is "zygote"; otherwise LAUNCH_SPAWN
+ * (the default).
+ */
+launch_backend_t launch_backend_from_env(void);
+
+/*
+ * start_zygote: Forks the zygote, a helper process that launches jobs for the shell from its own small
+ * address space. Call it at startup, before the shell's state grows.
+ *
+ * The shell sends each launch (path, argv, environment, working directory, process group, signal mask,
+ * and the stdin/stdout descriptors via SCM_RIGHTS) over a Unix socketpair. The zygote forks twice so
+ * the new process is orphaned at once. The shell is registered as a child subreaper, so the process
+ * is reparented to the shell, which reaps it as usual. The zygote sends back the pid once that has
+ * happened.
+ *
+ * Returns: true if the zygote is running; false if it could not be started (the error is printed).
+ */
+bool start_zygote(void);
+
+/*
+ * stop_zygote: Closes the connection to the zygote, which then exits, and reaps it.
+ */
+void stop_zygote(void);
+
+/*
+ * launch_process: Starts a new process running the program at path.
+ *
+ * backend: LAUNCH_SPAWN uses posix_spawn (vfork-style, cost independent of the shell's size) and falls
+ *          back to fork if the spawn itself cannot be set up; LAUNCH_ZYGOTE asks the zygote (see
+ *          start_zygote) and falls back to fork if it is not running or the request is too large;
+ *          LAUNCH_FORK always uses fork.
+ * path: The resolved program to execute.
+ * argv: The NULL-terminated argument vector.
+ * pgid: The process group to join, or 0 to make the new process a group leader.
+ * child_mask: The signal mask the new process starts with.
+ * in_fd, out_fd: Descriptors to install as the new process's stdin and stdout (STDIN_FILENO and
+ *                STDOUT_FILENO leave them unchanged). They should be close-on-exec in the shell so that
+ *                only the duplicated copies survive the exec.
+ * cpus: The CPUs the new process may run on, set before it execs; NULL inherits the shell's. posix_spawn
+ *       has no attribute for it, so LAUNCH_SPAWN restricts the shell itself around the spawn.
+ * bg_policy: The background policy (see apply_bg_policy) to give the new process before it execs; NULL
+ *            keeps the shell's priority. LAUNCH_SPAWN sets the scheduling class with a spawn attribute
+ *            and the nice level and I/O priority, which have none, as soon as the spawn returns.
+ *
+ * Returns: the pid of the new process, or -1 if it could not be started (the error is printed).
+ */
+pid_t launch_process(launch_backend_t backend, const char *path, char **argv, pid_t pgid,
+                     const sigset_t *child_mask, int in_fd, int out_fd, const cpu_mask_t *cpus,
+                     const bg_policy_t *bg_policy);
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef _LEXER_H_
+#define _LEXER_H_
+
+#include "arena.h"
+
+// Tokens and word text of typical lines fit in the lexer itself; longer lines spill to an arena or the heap
+#define LEX_INLINE_TOKENS 64
+#define LEX_INLINE_TEXT 1024
+
+typedef enum token_type {
+    TOK_WORD,       // A word, with its quotes and escapes removed
+    TOK_SEMI,       // ;
+    TOK_AMP,        // &
+    TOK_PIPE,       // |
+    TOK_IN,         // <
+    TOK_OUT,        // >
+    TOK_APPEND,     // >>
+    TOK_END         // End of the line
+} token_type_t;
+
+typedef struct token {
+    token_type_t type;  // The kind of token
+    char *text;         // The word (NUL-terminated), or the operator's spelling
+    int start;          // Offset of the token's first character in the line
+    int end;            // Offset just past the token's last character in the line
+} token_t;
+
+typedef struct lexer {
+    token_t *tokens;    // The tokens of the line, terminated by a TOK_END token
+    int num_tokens;     // The number of tokens before TOK_END
+    int capacity;       // The number of tokens allocated
+    char *text;         // The words, NUL-separated
+    arena_t *arena;     // Where long lines spill to, or NULL for the heap
+    token_t inline_tokens[LEX_INLINE_TOKENS];
+    char inline_text[LEX_INLINE_TEXT];
+} lexer_t;
+
+/*
+ * lex_line: Splits a command line into words and operators in a single pass.
+ *
+ * lex: The lexer to fill in. It must not be moved while its tokens are in use.
+ * line: The command line; it is not modified. Tokens record their offsets in it.
+ * arena: Memory for lines too long for the lexer's inline storage, or NULL to use the heap.
+ *
+ * Words are separated by blanks and operators (; & | < > >>). Inside single quotes every character is
+ * literal; inside double quotes a backslash escapes only \ and "; elsewhere a backslash escapes any
+ * character. A quoted operator is part of a word.
+ *
+ * Returns: the number of tokens (not counting TOK_END), or -1 on a syntax error (which is printed).
+ *
+ * Note: Release the lexer with lex_free, whatever lex_line returned.
+ */
+int lex_line(lexer_t *lex, const char *line, arena_t *arena);
+
+/*
+ * lex_free: Frees the heap memory a long line made the lexer allocate (arena memory goes with its arena).
+ */
+void lex_free(lexer_t *lex);
+
+#endif
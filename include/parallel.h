@@ -0,0 +1,26 @@
+#ifndef _PARALLEL_H_
+#define _PARALLEL_H_
+
+// Marks the end of the command template and the start of the argument list
+#define PARALLEL_ARGS_SEP ":::"
+
+// The word of the command template replaced by each argument
+#define PARALLEL_PLACEHOLDER "{}"
+
+/*
+ * builtin_parallel: Command: parallel [-j N] [-k] COMMAND [ARG...] [::: ITEM...]
+ *
+ * Runs COMMAND once per ITEM, or once per line of standard input when there is no `:::` (in a script
+ * read from stdin, the lines that follow the command; see read_input_line), keeping at most N
+ * (default: the number of CPUs) of them running and starting the next as soon as one finishes.
+ * Every {} in COMMAND is replaced by the item; without a {} the item is added as the last argument.
+ * Each run is a background job in the job table, so `jobs` lists the runs in flight. With -k the
+ * output of each run is held back and printed in the order of the items; otherwise runs write to
+ * standard output directly. COMMAND is always an external program and its stdin is /dev/null.
+ * Ctrl+C stops starting new runs and interrupts the running ones.
+ *
+ * Returns: NULL (sets builtin_status to 1 if anything could not be started).
+ */
+char *builtin_parallel(int argc, char **argv);
+
+#endif
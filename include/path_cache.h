@@ -0,0 +1,63 @@
+#ifndef _PATH_CACHE_H_
+#define _PATH_CACHE_H_
+
+#include <time.h>
+
+// Initial number of buckets in the command hash table (doubled as it fills up)
+#define PATH_CACHE_BUCKETS 64
+
+// Seconds a cached miss is trusted before PATH is searched again
+#define PATH_CACHE_MISS_TTL 5
+
+typedef struct path_entry {
+    char *name;               // The command name as typed (hash key)
+    char *path;               // The resolved absolute path, or NULL for a cached miss
+    time_t miss_time;         // When the miss was recorded (only used when path is NULL)
+    unsigned int hits;        // Number of lookups served by this entry
+    struct path_entry *next;  // Next entry in the same bucket
+} path_entry_t;
+
+typedef struct path_cache {
+    path_entry_t **buckets;   // Array of bucket chains
+    int num_buckets;          // Number of buckets in the table
+    int count;                // Number of entries in the table
+    char *path_env;           // The PATH value the entries were resolved against
+} path_cache_t;
+
+/*
+ * alloc_path_cache: Allocates an empty command -> absolute path cache.
+ *
+ * Returns: a pointer to the allocated cache or NULL on failure.
+ */
+path_cache_t *alloc_path_cache(void);
+
+/*
+ * resolve_path: Resolves a command name against PATH, consulting the cache first.
+ *
+ * cache: The cache to consult and populate.
+ * cmd: The command name (argv[0]). Names containing a '/' are returned unchanged.
+ *
+ * Returns: the absolute path of the executable, or NULL if it is not found in PATH. The returned
+ * string is owned by the cache and stays valid until the next call that modifies the cache.
+ *
+ * Note: The whole cache is dropped when PATH changes, a cached path is dropped once it is no longer
+ * executable, and misses are remembered for PATH_CACHE_MISS_TTL seconds.
+ */
+const char *resolve_path(path_cache_t *cache, const char *cmd);
+
+/*
+ * clear_path_cache: Removes every entry from the cache (`hash -r`).
+ */
+void clear_path_cache(path_cache_t *cache);
+
+/*
+ * print_path_cache: Prints the hit count and resolved path of every cached command (`hash`).
+ */
+void print_path_cache(path_cache_t *cache);
+
+/*
+ * free_path_cache: Frees the cache and all of its entries.
+ */
+void free_path_cache(path_cache_t *cache);
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef _PIPELINE_H_
+#define _PIPELINE_H_
+
+#include <stdbool.h>
+#include <signal.h>
+#include "shell.h"
+#include "lexer.h"
+#include "arena.h"
+#include "builtins.h"
+
+// Stages and arguments of typical jobs fit in the pipeline itself; longer jobs spill to an arena
+#define PIPELINE_INLINE_STAGES 8
+#define PIPELINE_INLINE_ARGS 64
+
+// A job starting with this word is timed: `time CMD` reports its real time and resource usage on stderr
+#define TIME_KEYWORD "time"
+
+// Represents one command of a `|` pipeline
+typedef struct stage {
+    char **argv;                // The arguments of the command (words of the lexer's line)
+    int argc;                   // The number of arguments in argv
+    const builtin_t *builtin;   // The registry entry of a built-in command, or NULL
+    char *in_file;              // The file named by `< file`, or NULL
+    char *out_file;             // The file named by `> file` or `>> file`, or NULL
+    bool append;                // true if out_file was given with `>>`
+} stage_t;
+
+// The stages of one job
+typedef struct pipeline {
+    stage_t *stages;    // The stages, in order
+    int num_stages;     // The number of stages
+    char **args;        // Storage for the argv of every stage
+    stage_t inline_stages[PIPELINE_INLINE_STAGES];
+    char *inline_args[PIPELINE_INLINE_ARGS];
+} pipeline_t;
+
+/*
+ * parse_pipeline: Splits the tokens of a job into its `|` separated stages and their `<`, `>` and `>>`
+ * redirections.
+ *
+ * tokens: The job's tokens (from lex_line), not including the `;` or `&` that ends it.
+ * num_tokens: The number of tokens.
+ * pipeline: The pipeline to fill in. Its argv strings point into the lexer, which must outlive it.
+ * arena: Memory for jobs too long for the pipeline's inline storage.
+ *
+ * Returns: the number of stages, 0 if the job is empty, or -1 on a syntax error (which is printed).
+ */
+int parse_pipeline(const token_t *tokens, int num_tokens, pipeline_t *pipeline, arena_t *arena);
+
+/*
+ * run_job: Runs a single job: a command or a pipeline, launched as one process group and tracked as one
+ * entry in the job table.
+ *
+ * shell: The current shell state value.
+ * line: The command line the tokens were lexed from; the job's text in it is kept for the job table.
+ * tokens: The job's tokens, not including the `;` or `&` that ends it.
+ * num_tokens: The number of tokens.
+ * job_type: FOREGROUND or BACKGROUND.
+ * child_mask: The signal mask every launched process starts with.
+ *
+ * Note: Stages are connected with pipes and redirections hand the opened file to the stage directly, so
+ * data never passes through the shell. A builtin that is the whole job runs in the shell itself; a
+ * builtin inside a pipeline runs in a forked copy of the shell. A background job that finds the job
+ * table full is queued unforked (see admission.h); `@prio=N` in front of the job sets its priority
+ * there. `@cpus=LIST` in front of a job restricts its processes to those CPUs before they exec; a
+ * background job without it is placed by the shell's -A policy (see place_job). A foreground job that
+ * starts with `time` has its real, user and system time, peak RSS and context switches printed on stderr
+ * once it finishes.
+ */
+void run_job(msh_t *shell, const char *line, const token_t *tokens, int num_tokens, int job_type,
+             const sigset_t *child_mask);
+
+/*
+ * admit_queued_jobs: Launches queued background jobs, in admission order, while the job table has room.
+ */
+void admit_queued_jobs(msh_t *shell);
+
+#endif
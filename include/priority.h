@@ -0,0 +1,53 @@
+#ifndef _PRIORITY_H_
+#define _PRIORITY_H_
+
+#include <stdbool.h>
+#include "job.h"          // For job_t definitions
+
+// Environment variable that lowers the priority of background jobs: "batch" or "idle" ("normal" or
+// unset leaves them at the shell's priority)
+#define BG_SCHED_ENV "MSH_BG_SCHED"
+
+// Environment variable that overrides the nice level the MSH_BG_SCHED class gives background jobs
+#define BG_NICE_ENV "MSH_BG_NICE"
+
+// How background jobs are scheduled; foreground jobs always run like the shell
+typedef struct bg_policy {
+    bool enabled;       // false leaves background jobs at the shell's priority
+    int sched;          // SCHED_BATCH or SCHED_IDLE
+    int nice;           // The nice level of background jobs
+    int ioprio;         // The I/O priority of background jobs (class and level, as ioprio_set takes it)
+    int fg_nice;        // The shell's own nice level, which foreground jobs keep
+} bg_policy_t;
+
+/*
+ * read_bg_policy: Reads the background scheduling policy from MSH_BG_SCHED and MSH_BG_NICE.
+ *
+ * "batch" gives background jobs SCHED_BATCH, nice 10 and the lowest best-effort I/O priority; "idle"
+ * gives them SCHED_IDLE, nice 19 and the idle I/O class, so they only get the CPU and the disk when
+ * nothing else wants them. An unknown class is reported and ignored.
+ */
+void read_bg_policy(bg_policy_t *policy);
+
+/*
+ * apply_bg_policy: Gives one process (0 for the caller) the background scheduling class, nice level and
+ * I/O priority. The launch paths call it in a background job's processes before they exec (see
+ * launch_process), so everything the job forks later inherits the policy.
+ *
+ * Returns: 0 on success (or if the policy is disabled); otherwise -1 with errno set.
+ */
+int apply_bg_policy(const bg_policy_t *policy, pid_t pid);
+
+/*
+ * prioritize_job: Gives a running job the background policy, or the shell's normal priority, as it moves
+ * between the foreground and the background (fg, bg).
+ *
+ * The scheduling class is set on each live process of the job; the nice level and the I/O priority on
+ * its whole process group, which includes the processes it has started meanwhile.
+ *
+ * Returns: 0 on success (or if the policy is disabled), otherwise the errno of the first failure.
+ * Lowering a priority always works; raising it back for fg may need CAP_SYS_NICE (EPERM, EACCES).
+ */
+int prioritize_job(const bg_policy_t *policy, const job_t *job, bool background);
+
+#endif
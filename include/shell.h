@@ -4,19 +4,47 @@
 #include <stdbool.h>
 #include "job.h"          // For job_t definitions
 #include "history.h"      // For history_t definitions
+#include "path_cache.h"   // For path_cache_t definitions
+#include "launch.h"       // For launch_backend_t definitions
+#include "arena.h"        // For arena_t definitions
+#include "admission.h"    // For admission_queue_t definitions
+#include "priority.h"     // For bg_policy_t definitions
 
 // Default values for shell configuration
 #define DEFAULT_MAX_JOBS 16
 #define DEFAULT_MAX_LINE 1024
 #define DEFAULT_MAX_HISTORY 10
 
+// Environment variable with the seconds exit_shell waits for background jobs before it sends them
+// SIGTERM, and then SIGKILL after as long again; unset or 0 waits for them however long they take
+#define EXIT_GRACE_ENV "MSH_EXIT_GRACE"
+
+// The input of the batch loop (msh reading a script from a file or a pipe). The lines after the one
+// running belong to whoever reads stdin next, so builtins that read stdin take them from here.
+typedef struct script_input {
+    char *text;           // The input read (or mapped) so far
+    size_t len;           // Bytes in text
+    size_t pos;           // Bytes of text already run or read by a builtin
+    size_t cap;           // Bytes allocated for text; 0 if it is mapped and holds the whole script
+    int fd;               // The descriptor more input is read from
+    bool eof;             // true once there is no more input than text holds
+} script_input_t;
+
 // Represents the state of the shell
 typedef struct msh {
     int max_jobs;         // Maximum number of jobs allowed
     int max_line;         // Maximum characters per line
     int max_history;      // Maximum commands in history
-    job_t *jobs;          // Array of jobs
+    job_table_t *jobs;    // Job table indexed by pid and job id
     history_t *history;   // Shell history structure
+    path_cache_t *path_cache; // Command name -> absolute path cache
+    launch_backend_t launch_backend; // How jobs are started (posix_spawn or fork)
+    arena_t *arena;       // Transient memory of the command line being evaluated
+    admission_queue_t *queue; // Background jobs waiting for room in the job table
+    bool notify_now;      // set -b: report finished background jobs when they are reaped, not at the prompt
+    affinity_policy_t affinity; // How background jobs are spread over CPUs (msh -A)
+    bg_policy_t bg_policy; // How background jobs are scheduled (MSH_BG_SCHED)
+    script_input_t *input; // The batch loop's input, or NULL when stdin is a terminal or with -c
 } msh_t;
 
 extern msh_t *shell;
@@ -44,6 +72,12 @@ msh_t *alloc_shell(int max_jobs, int max_line, int max_history);
  */
 char *parse_tok(char *line, int *job_type);
 
+/*
+ * builtin_cmd: Runs a built-in command through the builtin registry (see builtins.h).
+ *
+ * Returns: the command line to run next for a history expansion (!N, !prefix, !?text), or NULL. The
+ * string lives in the shell's arena until the current command line is finished; do not free it.
+ */
 char *builtin_cmd(int argc, char **argv);
 
 /*
@@ -59,6 +93,24 @@ char *builtin_cmd(int argc, char **argv);
  */
 char **separate_args(char *line, int *argc, bool *is_builtin);
 
+/*
+ * waitfg: Blocks until the foreground job with the given pid has terminated or stopped.
+ *
+ * pid: The process id of the foreground job.
+ *
+ * Note: The wait sleeps in poll on the signal event fd and handles child state changes as they arrive,
+ * so there is no polling delay.
+ */
+void waitfg(pid_t pid);
+
+/*
+ * report_completions: Prints a notice for every background job that finished since the last report
+ * ("[JID] PID DONE COMMAND") and empties the completion queue. Costs nothing when no job finished.
+ *
+ * shell: The current shell state value.
+ */
+void report_completions(msh_t *shell);
+
 /*
  * evaluate: Executes the provided command line string.
  *
@@ -66,10 +118,30 @@ char **separate_args(char *line, int *argc, bool *is_builtin);
  *
  * line: The command line string to evaluate.
  *
+ * Note: Transient memory comes from shell->arena; the caller resets it once the line is finished.
  * Returns: Non-zero if the command executed wants the shell program to close. Otherwise, a 0 is returned.
  */
 int evaluate(msh_t *shell, char *line);
 
+/*
+ * fill_script_input: Reads the next block of a script into input, first dropping the text before
+ * input->pos and growing text if it is full. Sets input->eof at end-of-file or on an error.
+ *
+ * Returns: true if text got more input.
+ */
+bool fill_script_input(script_input_t *input);
+
+/*
+ * read_input_line: Reads the next line of the shell's standard input on behalf of a builtin (parallel).
+ * In batch mode that is the next line of the script, which the batch loop then skips; otherwise it is
+ * read from stdin.
+ *
+ * line, cap: A malloc'd buffer and its size, as getline takes them; grown as needed.
+ *
+ * Returns: the length of the line without its newline, or -1 at end-of-file.
+ */
+ssize_t read_input_line(msh_t *shell, char **line, size_t *cap);
+
 /*
  * white_space: Determines whether a string contains only whitespace characters.
  *
@@ -82,6 +154,11 @@ int white_space(const char *str);
 /*
  * exit_shell: Closes down the shell by deallocating the shell state.
  *
+ * Every background job, and every queued one as it is admitted, is waited for in one event loop,
+ * reaping them in whatever order they finish. With MSH_EXIT_GRACE set, the jobs still running when
+ * it runs out get SIGTERM, and SIGKILL once it runs out again; if any are left after a third grace
+ * period they are reported and the shell exits anyway. The history is flushed and freed.
+ *
  * shell: The current shell state value.
  */
 void exit_shell(msh_t *shell);
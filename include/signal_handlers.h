@@ -1,9 +1,54 @@
 #ifndef _SIGNAL_HANDLERS_H_
 #define _SIGNAL_HANDLERS_H_
 
+#include <signal.h>
+#include <stdbool.h>
+
 /*
- * Initializes all signal handlers for the shell
+ * Initializes signal delivery for the shell. SIGCHLD, SIGINT and SIGTSTP are not handled in signal
+ * context: they are read from a signalfd (or, where that is unavailable, written to a self-pipe by
+ * minimal handlers) and processed by handle_signal_events. Calling it again has no effect.
  */
 void initialize_signal_handlers();
 
+/*
+ * signal_event_fd: The descriptor that becomes readable when a signal is pending, for use with poll.
+ */
+int signal_event_fd(void);
+
+/*
+ * child_signal_mask: The signal mask the shell started with, which launched jobs must restore.
+ */
+const sigset_t *child_signal_mask(void);
+
+/*
+ * handle_signal_events: Drains every pending signal, then reaps all children that changed state in
+ * one batch and applies the job table updates. SIGINT and SIGTSTP are forwarded to the foreground job.
+ *
+ * Returns: the number of signals drained.
+ */
+int handle_signal_events(void);
+
+/*
+ * reap_children: Reaps every child that has exited, stopped or continued and applies the job table
+ * updates, without waiting for the SIGCHLD. For callers that learn of an exit another way (a pidfd).
+ */
+void reap_children(void);
+
+/*
+ * wait_signal_events: Blocks until a signal is pending (or timeout_ms elapses; -1 waits forever) and
+ * handles it.
+ *
+ * Returns: true if any signal was handled.
+ */
+bool wait_signal_events(int timeout_ms);
+
+/*
+ * take_interrupt: Reports a SIGINT that handle_signal_events had no foreground job to forward to, for
+ * builtins that wait on jobs of their own. The report is cleared.
+ *
+ * Returns: true if such a SIGINT arrived since the last call.
+ */
+bool take_interrupt(void);
+
 #endif
@@ -0,0 +1,80 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Environment variable that turns tracing on (any value but "" and "0")
+#define TRACE_ENV "MSH_TRACE"
+
+// Number of events the ring holds (a power of two); the oldest are overwritten
+#define TRACE_RING_SIZE 65536
+
+// Number of power-of-two latency buckets in a histogram (1us up to about 35 minutes)
+#define TRACE_BUCKETS 32
+
+// First bytes of a dump file written by `stats -d`
+#define TRACE_DUMP_MAGIC "MSHTRACE"
+#define TRACE_DUMP_VERSION 1
+
+typedef enum trace_type {
+    TRACE_LINE_READ,        // A command line was read
+    TRACE_PARSED,           // The line was lexed
+    TRACE_PATH_RESOLVED,    // A command was resolved against PATH (arg: stage number)
+    TRACE_LAUNCHED,         // fork or posix_spawn returned in the shell (arg: pid). posix_spawn returns once
+                            // the child has called exec, so this marks exec started for that backend.
+    TRACE_REAPED,           // A child was reaped (arg: pid)
+    TRACE_PROMPT,           // The line is finished and the shell is ready for the next (the prompt is printed)
+    TRACE_NUM_TYPES
+} trace_type_t;
+
+// One recorded event (16 bytes; the dump file is an array of these)
+typedef struct trace_event {
+    uint64_t ns;            // CLOCK_MONOTONIC time in nanoseconds
+    uint32_t type;          // A trace_type_t
+    int32_t arg;            // The pid or stage number, or 0
+} trace_event_t;
+
+// The header of a dump file, followed by `count` events oldest first
+typedef struct trace_dump_header {
+    char magic[8];          // TRACE_DUMP_MAGIC
+    uint32_t version;       // TRACE_DUMP_VERSION
+    uint32_t count;         // The number of events that follow
+} trace_dump_header_t;
+
+// true if tracing is on; read by TRACE so that a disabled trace point costs one predicted branch
+extern bool trace_enabled;
+
+/*
+ * TRACE: Records an event of the given type with its argument, if tracing is on.
+ */
+#define TRACE(type, arg) \
+    do { \
+        if (__builtin_expect(trace_enabled, 0)) trace_record((type), (arg)); \
+    } while (0)
+
+/*
+ * trace_init: Turns tracing on if MSH_TRACE is set. Calling it again has no effect.
+ */
+void trace_init(void);
+
+/*
+ * trace_record: Appends an event to the ring. Use the TRACE macro instead, which skips the call when
+ * tracing is off.
+ */
+void trace_record(trace_type_t type, int arg);
+
+/*
+ * builtin_stats: Command: stats [-r] [-d FILE]
+ *
+ * Prints a latency histogram for each phase of running a command line, computed from the events in
+ * the ring: parse (line read to lexed), resolve (to the PATH lookup of a stage), launch (PATH lookup
+ * to fork/posix_spawn returning), run (launch to reaping, per process) and line (line read to the
+ * next prompt). -d writes the ring to FILE for offline analysis (see trace_dump_header_t); -r empties
+ * the ring.
+ *
+ * Returns: NULL.
+ */
+char *builtin_stats(int argc, char **argv);
+
+#endif
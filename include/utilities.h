@@ -0,0 +1,20 @@
+#ifndef _UTILITIES_H_
+#define _UTILITIES_H_
+
+/*
+ * In-process versions of common utilities, registered in the builtin registry (see builtins.h) so that
+ * scripts do not pay a fork and exec for them. They follow the coreutils versions: echo (-n, -e, -E),
+ * true, false, test and [ (file, string and integer tests with !, -a, -o and parentheses), printf (the
+ * format is reused until every argument is consumed) and pwd (-L, -P). `command NAME` runs the external
+ * program instead.
+ *
+ * Each sets builtin_status to its exit status and returns NULL.
+ */
+char *utility_echo(int argc, char **argv);
+char *utility_true(int argc, char **argv);
+char *utility_false(int argc, char **argv);
+char *utility_test(int argc, char **argv);
+char *utility_printf(int argc, char **argv);
+char *utility_pwd(int argc, char **argv);
+
+#endif
@@ -0,0 +1,52 @@
+#!/bin/bash
+
+# Runs the msh benchmark suite and prints one line per measurement as
+# space-separated key=value pairs, starting with bench=NAME and ending with
+# the git revision (rev=) the shell was built from, so that results of
+# different builds can be collected in one file and compared.
+#
+# Measures: startup-to-exit time on an empty script, foreground command rate
+# (`/usr/bin/true` loop), background launch rate per launch backend,
+# in-process utilities against external programs, reaping rate with N
+# concurrent jobs, parse_tok/separate_args and lexer throughput on generated
+# lines, and history add/lookup at 10^3 to 10^6 lines.
+#
+# Usage: ./bench.sh [-q] [OUT]
+#   -q   quick run (fewer commands per shell benchmark)
+#   OUT  also append the results to the file OUT
+
+N=10000
+if [ "$1" == "-q" ]; then
+    N=1000
+    shift
+fi
+OUT=${1:-/dev/null}
+
+# Move to the root directory of the project
+cd "$(dirname "$0")/.." || exit 1
+ROOT=$PWD
+REV=$(git describe --always --dirty 2> /dev/null || echo unknown)
+WORK=$(mktemp -d)
+trap 'rm -rf $WORK' EXIT
+
+# Build optimized copies of the shell and the C benchmarks
+SRCS=$(ls src/*.c | grep -v msh.c)
+gcc -O2 -I./include/ -o $WORK/msh src/*.c || { echo "Build failed."; exit 1; }
+for bench in bench_parse bench_lexer bench_reap bench_history; do
+    gcc -O2 -I./include/ -o $WORK/$bench tests/$bench.c $SRCS || { echo "Build of $bench failed."; exit 1; }
+done
+
+# Run where ../data does not exist, so the shell keeps its history in memory
+mkdir $WORK/run
+cd $WORK/run
+
+{
+    $ROOT/tests/bench_startup.sh $((N / 10)) $WORK/msh
+    $ROOT/tests/bench_waitfg.sh $N $WORK/msh
+    $ROOT/tests/bench_launch.sh $N $WORK/msh
+    $ROOT/tests/bench_utilities.sh $N $WORK/msh
+    $WORK/bench_reap
+    $WORK/bench_parse
+    $WORK/bench_lexer
+    $WORK/bench_history
+} | grep --line-buffered '^bench=' | sed -u "s/\$/ rev=$REV/" | tee -a $OUT
@@ -0,0 +1,99 @@
+#include "admission.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// true if a is admitted before b
+static bool admitted_before(const queued_job_t *a, const queued_job_t *b) {
+    return a->priority != b->priority ? a->priority > b->priority : a->seq < b->seq;
+}
+
+static void swap_jobs(queued_job_t *a, queued_job_t *b) {
+    queued_job_t tmp = *a;
+    *a = *b;
+    *b = tmp;
+}
+
+admission_queue_t *alloc_admission_queue(void) {
+    admission_queue_t *queue = calloc(1, sizeof(admission_queue_t));
+    if (!queue) {
+        perror("calloc");
+        return NULL;
+    }
+    queue->heap = malloc(ADMISSION_QUEUE_MIN * sizeof(queued_job_t));
+    if (!queue->heap) {
+        perror("malloc");
+        free(queue);
+        return NULL;
+    }
+    queue->capacity = ADMISSION_QUEUE_MIN;
+    return queue;
+}
+
+bool enqueue_job(admission_queue_t *queue, const char *cmd_line, int priority) {
+    if (queue->count == queue->capacity) {
+        queued_job_t *heap = realloc(queue->heap, queue->capacity * 2 * sizeof(queued_job_t));
+        if (!heap) {
+            perror("realloc");
+            return false;
+        }
+        queue->heap = heap;
+        queue->capacity *= 2;
+    }
+    char *copy = strdup(cmd_line);
+    if (!copy) {
+        perror("strdup");
+        return false;
+    }
+
+    int i = queue->count++;
+    queued_job_t *heap = queue->heap;
+    heap[i].cmd_line = copy;
+    heap[i].priority = priority;
+    heap[i].seq = queue->next_seq++;
+    clock_gettime(CLOCK_MONOTONIC, &heap[i].queued_at);
+    while (i > 0 && admitted_before(&heap[i], &heap[(i - 1) / 2])) { // sift up
+        swap_jobs(&heap[i], &heap[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+    return true;
+}
+
+char *dequeue_job(admission_queue_t *queue) {
+    if (queue->count == 0) return NULL;
+    queued_job_t *heap = queue->heap;
+    char *cmd_line = heap[0].cmd_line;
+    heap[0] = heap[--queue->count];
+
+    int i = 0;
+    for (;;) { // sift down
+        int first = i, left = 2 * i + 1, right = 2 * i + 2;
+        if (left < queue->count && admitted_before(&heap[left], &heap[first])) first = left;
+        if (right < queue->count && admitted_before(&heap[right], &heap[first])) first = right;
+        if (first == i) break;
+        swap_jobs(&heap[i], &heap[first]);
+        i = first;
+    }
+    return cmd_line;
+}
+
+static int compare_admission(const void *a, const void *b) {
+    const queued_job_t *x = *(const queued_job_t **)a, *y = *(const queued_job_t **)b;
+    return admitted_before(x, y) ? -1 : admitted_before(y, x) ? 1 : 0;
+}
+
+void sort_queued_jobs(const admission_queue_t *queue, const queued_job_t **order) {
+    for (int i = 0; i < queue->count; i++) {
+        order[i] = &queue->heap[i];
+    }
+    qsort(order, queue->count, sizeof(order[0]), compare_admission);
+}
+
+void free_admission_queue(admission_queue_t *queue) {
+    if (!queue) return;
+    for (int i = 0; i < queue->count; i++) {
+        free(queue->heap[i].cmd_line);
+    }
+    free(queue->heap);
+    free(queue);
+}
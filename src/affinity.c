@@ -0,0 +1,213 @@
+#define _GNU_SOURCE     // For sched_setaffinity and cpu_set_t
+#include "affinity.h"
+#include "job.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <sched.h>
+
+// Largest number of NUMA nodes place_job tells apart
+#define MAX_NUMA_NODES 64
+
+static bool has_cpu(const cpu_mask_t *mask, int cpu) {
+    return mask->words[cpu / 64] >> (cpu % 64) & 1;
+}
+
+static void add_cpu(cpu_mask_t *mask, int cpu) {
+    mask->words[cpu / 64] |= 1ULL << (cpu % 64);
+}
+
+static bool overlaps(const cpu_mask_t *a, const cpu_mask_t *b) {
+    for (int w = 0; w < AFFINITY_MAX_CPUS / 64; w++) {
+        if (a->words[w] & b->words[w]) return true;
+    }
+    return false;
+}
+
+bool parse_cpu_list(const char *list, cpu_mask_t *mask) {
+    memset(mask, 0, sizeof(*mask));
+    bool any = false;
+    const char *p = list;
+    while (*p && *p != '\n') {
+        if (!isdigit((unsigned char)*p)) return false;
+        char *end;
+        long first = strtol(p, &end, 10), last = first;
+        if (*end == '-') {
+            p = end + 1;
+            if (!isdigit((unsigned char)*p)) return false;
+            last = strtol(p, &end, 10);
+        }
+        if (last < first || last >= AFFINITY_MAX_CPUS) return false;
+        for (long cpu = first; cpu <= last; cpu++) {
+            add_cpu(mask, cpu);
+        }
+        any = true;
+        p = end;
+        if (*p == ',') p++;
+        else if (*p && *p != '\n') return false;
+    }
+    return any;
+}
+
+void format_cpu_list(const cpu_mask_t *mask, char *buf, size_t size) {
+    size_t len = 0;
+    buf[0] = '\0';
+    for (int cpu = 0; cpu < AFFINITY_MAX_CPUS && len < size; cpu++) {
+        if (!has_cpu(mask, cpu)) continue;
+        int last = cpu;
+        while (last + 1 < AFFINITY_MAX_CPUS && has_cpu(mask, last + 1)) last++;
+        int n = last > cpu ? snprintf(buf + len, size - len, "%s%d-%d", len ? "," : "", cpu, last)
+                           : snprintf(buf + len, size - len, "%s%d", len ? "," : "", cpu);
+        if (n < 0) break;
+        len += n;
+        cpu = last;
+    }
+}
+
+bool parse_affinity_policy(const char *name, affinity_policy_t *policy) {
+    if (strcmp(name, "rr") == 0) *policy = AFFINITY_RR;
+    else if (strcmp(name, "numa") == 0) *policy = AFFINITY_NUMA;
+    else if (strcmp(name, "none") == 0) *policy = AFFINITY_NONE;
+    else return false;
+    return true;
+}
+
+bool get_cpu_mask(pid_t pid, cpu_mask_t *mask) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(pid, sizeof(set), &set) == -1) return false;
+    memset(mask, 0, sizeof(*mask));
+    for (int cpu = 0; cpu < AFFINITY_MAX_CPUS && cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &set)) add_cpu(mask, cpu);
+    }
+    return true;
+}
+
+int set_cpu_mask(pid_t pid, const cpu_mask_t *mask) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu = 0; cpu < AFFINITY_MAX_CPUS && cpu < CPU_SETSIZE; cpu++) {
+        if (has_cpu(mask, cpu)) CPU_SET(cpu, &set);
+    }
+    return sched_setaffinity(pid, sizeof(set), &set);
+}
+
+void nth_cpu(const cpu_mask_t *mask, int n, cpu_mask_t *one) {
+    int count = 0;
+    for (int w = 0; w < AFFINITY_MAX_CPUS / 64; w++) {
+        count += __builtin_popcountll(mask->words[w]);
+    }
+    *one = *mask;
+    if (count == 0) return;
+    n %= count;
+    memset(one, 0, sizeof(*one));
+    for (int cpu = 0; cpu < AFFINITY_MAX_CPUS; cpu++) {
+        if (has_cpu(mask, cpu) && n-- == 0) {
+            add_cpu(one, cpu);
+            return;
+        }
+    }
+}
+
+// The CPUs the shell may use and its NUMA nodes, read once
+static bool topology_ready = false;
+static cpu_mask_t allowed;
+static cpu_mask_t nodes[MAX_NUMA_NODES];
+static int num_nodes = 0;
+
+// reads the CPUs of every NUMA node that has some the shell may use; one node of them all if there is no NUMA
+static void read_topology(void) {
+    if (topology_ready) return;
+    topology_ready = true;
+    if (!get_cpu_mask(0, &allowed)) {
+        memset(&allowed, 0, sizeof(allowed));
+        add_cpu(&allowed, 0);
+    }
+
+    DIR *dir = opendir(NUMA_NODE_DIR);
+    struct dirent *entry;
+    while (dir && (entry = readdir(dir)) && num_nodes < MAX_NUMA_NODES) {
+        if (strncmp(entry->d_name, "node", 4) != 0 || !isdigit((unsigned char)entry->d_name[4])) continue;
+        char path[512], list[4096];
+        snprintf(path, sizeof(path), "%s/%s/cpulist", NUMA_NODE_DIR, entry->d_name);
+        FILE *file = fopen(path, "r");
+        if (!file) continue;
+        cpu_mask_t node;
+        bool ok = fgets(list, sizeof(list), file) && parse_cpu_list(list, &node);
+        fclose(file);
+        if (!ok) continue; // a memory-only node
+        for (int w = 0; w < AFFINITY_MAX_CPUS / 64; w++) {
+            node.words[w] &= allowed.words[w];
+        }
+        if (overlaps(&node, &allowed)) nodes[num_nodes++] = node;
+    }
+    if (dir) closedir(dir);
+    if (num_nodes == 0) nodes[num_nodes++] = allowed;
+}
+
+// AFFINITY_RR: the nprocs allowed CPUs with the fewest pinned jobs, taken round-robin among equals
+static void place_round_robin(const job_table_t *jobs, int nprocs, cpu_mask_t *mask) {
+    static int next = 0; // where the search for the least used CPU starts
+    static int load[AFFINITY_MAX_CPUS];
+    memset(load, 0, sizeof(load));
+    for (int i = 0; i < jobs->capacity; i++) {
+        const job_t *job = &jobs->jobs[i];
+        if (job->state == UNDEFINED || !job->pinned) continue;
+        for (int w = 0; w < AFFINITY_MAX_CPUS / 64; w++) {
+            for (uint64_t bits = job->cpus.words[w]; bits; bits &= bits - 1) {
+                load[w * 64 + __builtin_ctzll(bits)]++;
+            }
+        }
+    }
+
+    memset(mask, 0, sizeof(*mask));
+    for (int n = 0; n < nprocs; n++) {
+        int best = -1;
+        for (int i = 0; i < AFFINITY_MAX_CPUS; i++) {
+            int cpu = (next + i) % AFFINITY_MAX_CPUS;
+            if (has_cpu(&allowed, cpu) && !has_cpu(mask, cpu) && (best == -1 || load[cpu] < load[best])) {
+                best = cpu;
+            }
+        }
+        if (best == -1) break; // every allowed CPU is in use by this job
+        add_cpu(mask, best);
+        next = best + 1;
+    }
+}
+
+// AFFINITY_NUMA: the node whose CPUs the fewest pinned jobs use, taken round-robin among equals
+static void place_numa(const job_table_t *jobs, cpu_mask_t *mask) {
+    static int next = 0;
+    int best = -1, best_load = 0;
+    for (int i = 0; i < num_nodes; i++) {
+        int node = (next + i) % num_nodes, load = 0;
+        for (int j = 0; j < jobs->capacity; j++) {
+            const job_t *job = &jobs->jobs[j];
+            if (job->state != UNDEFINED && job->pinned && overlaps(&job->cpus, &nodes[node])) load++;
+        }
+        if (best == -1 || load < best_load) {
+            best = node;
+            best_load = load;
+        }
+    }
+    *mask = nodes[best];
+    next = best + 1;
+}
+
+bool usable_cpus(cpu_mask_t *mask) {
+    read_topology();
+    for (int w = 0; w < AFFINITY_MAX_CPUS / 64; w++) {
+        mask->words[w] &= allowed.words[w];
+    }
+    return overlaps(mask, &allowed);
+}
+
+bool place_job(affinity_policy_t policy, const job_table_t *jobs, int nprocs, cpu_mask_t *mask) {
+    if (policy == AFFINITY_NONE) return false;
+    read_topology();
+    if (policy == AFFINITY_RR) place_round_robin(jobs, nprocs, mask);
+    else place_numa(jobs, mask);
+    return true;
+}
@@ -0,0 +1,54 @@
+/*
+ * Allocation-counting build. Compile the shell with -DMSH_ALLOC_COUNT and link it with
+ *
+ *     -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=strdup,--wrap=strndup
+ *
+ * so that every allocation made by the shell's own code is counted here. The total is printed to
+ * stderr when the shell exits. Allocations made inside the C library (stdio buffers, getline,
+ * posix_spawn) are not counted. tests/bench_alloc.sh turns the totals into allocations per command.
+ */
+#ifdef MSH_ALLOC_COUNT
+
+#include <stdio.h>
+#include <stddef.h>
+
+// The real allocators, reached through the linker's --wrap
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+char *__real_strdup(const char *s);
+char *__real_strndup(const char *s, size_t n);
+
+static unsigned long allocations = 0;
+
+void *__wrap_malloc(size_t size) {
+    allocations++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size) {
+    allocations++;
+    return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    allocations++;
+    return __real_realloc(ptr, size);
+}
+
+char *__wrap_strdup(const char *s) {
+    allocations++;
+    return __real_strdup(s);
+}
+
+char *__wrap_strndup(const char *s, size_t n) {
+    allocations++;
+    return __real_strndup(s, n);
+}
+
+// runs when the shell exits (children leave with _exit and print nothing)
+__attribute__((destructor)) static void report_allocations(void) {
+    fprintf(stderr, "alloc_count: allocations=%lu\n", allocations);
+}
+
+#endif
@@ -0,0 +1,81 @@
+#include "arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdalign.h>
+#include <stdbool.h>
+
+#define ARENA_ALIGN alignof(max_align_t)
+
+// adds a chunk with room for at least size bytes
+static bool add_chunk(arena_t *arena, size_t size) {
+    if (size < ARENA_CHUNK_SIZE) size = ARENA_CHUNK_SIZE;
+    arena_chunk_t *chunk = malloc(sizeof(arena_chunk_t) + size);
+    if (!chunk) {
+        perror("malloc");
+        return false;
+    }
+    chunk->next = arena->chunks;
+    chunk->size = size;
+    arena->chunks = chunk;
+    arena->ptr = chunk->data;
+    arena->end = chunk->data + size;
+    return true;
+}
+
+arena_t *alloc_arena(void) {
+    arena_t *arena = malloc(sizeof(arena_t));
+    if (!arena) {
+        perror("malloc");
+        return NULL;
+    }
+    arena->chunks = NULL;
+    if (!add_chunk(arena, ARENA_CHUNK_SIZE)) {
+        free(arena);
+        return NULL;
+    }
+    return arena;
+}
+
+void *arena_alloc(arena_t *arena, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    if ((size_t)(arena->end - arena->ptr) < size && !add_chunk(arena, size)) {
+        return NULL;
+    }
+    void *p = arena->ptr;
+    arena->ptr += size;
+    return p;
+}
+
+char *arena_strndup(arena_t *arena, const char *s, size_t len) {
+    len = strnlen(s, len);
+    char *copy = arena_alloc(arena, len + 1);
+    if (copy) {
+        memcpy(copy, s, len);
+        copy[len] = '\0';
+    }
+    return copy;
+}
+
+char *arena_strdup(arena_t *arena, const char *s) {
+    return arena_strndup(arena, s, strlen(s));
+}
+
+void arena_reset(arena_t *arena) {
+    while (arena->chunks->next) { // free every chunk but the first
+        arena_chunk_t *next = arena->chunks->next;
+        free(arena->chunks);
+        arena->chunks = next;
+    }
+    arena->ptr = arena->chunks->data;
+    arena->end = arena->chunks->data + arena->chunks->size;
+}
+
+void free_arena(arena_t *arena) {
+    while (arena->chunks) {
+        arena_chunk_t *next = arena->chunks->next;
+        free(arena->chunks);
+        arena->chunks = next;
+    }
+    free(arena);
+}
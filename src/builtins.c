@@ -0,0 +1,474 @@
+#include "builtins.h"
+#include "shell.h"
+#include "utilities.h"
+#include "parallel.h"
+#include "trace.h"
+#include "pipeline.h"   // For admit_queued_jobs
+#include "signal_handlers.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>      // For isdigit
+#include <signal.h>     // For kill
+#include <time.h>       // For clock_gettime
+#include <sys/wait.h>   // For WIFSIGNALED
+#include <sys/epoll.h>
+#include <sys/syscall.h> // For SYS_pidfd_send_signal
+#include <unistd.h>
+#include <errno.h>
+
+// prints the accounting line of `jobs -v`
+static void print_job_usage(const job_usage_t *usage) {
+    const struct rusage *ru = &usage->rusage;
+    printf("\telapsed %.3fs user %.3fs sys %.3fs maxrss %ldK ctxsw %ld/%ld",
+           elapsed_seconds(&usage->start, &usage->end),
+           ru->ru_utime.tv_sec + ru->ru_utime.tv_usec / 1e6, ru->ru_stime.tv_sec + ru->ru_stime.tv_usec / 1e6,
+           ru->ru_maxrss, ru->ru_nvcsw, ru->ru_nivcsw);
+    if (usage->end.tv_sec != 0 || usage->end.tv_nsec != 0) {
+        if (WIFSIGNALED(usage->status)) printf(" signal %d", WTERMSIG(usage->status));
+        else printf(" exit %d", WEXITSTATUS(usage->status));
+    }
+    putchar('\n');
+}
+
+// prints the CPUs a job may run on for `jobs -v`: its own if it is pinned, otherwise the shell's
+static void print_job_cpus(const job_t *job) {
+    cpu_mask_t cpus = job->cpus;
+    char list[256];
+    if (!job->pinned && !get_cpu_mask(0, &cpus)) return;
+    format_cpu_list(&cpus, list, sizeof(list));
+    printf("\tcpus %s%s\n", list, job->pinned ? "" : " (not pinned)");
+}
+
+// Command: jobs [-v]
+static char *builtin_jobs(int argc, char **argv) {
+    job_table_t *table = shell->jobs;
+    bool verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+    for (int w = 0; w < (table->capacity + 63) / 64; w++) { // visit only the slots in use
+        for (uint64_t bits = table->used[w]; bits; bits &= bits - 1) {
+            job_t *job = &table->jobs[w * 64 + __builtin_ctzll(bits)];
+            printf("[%d] %d %s %s\n",
+                   job->jid,
+                   job->pid,
+                   job->state == BACKGROUND ? "RUNNING" : "STOPPED",
+                   job->cmd_line);
+            if (verbose) {
+                print_job_usage(&job->usage); // CPU time covers the processes reaped so far
+                print_job_cpus(job);
+            }
+        }
+    }
+    if (verbose) { // and the jobs that finished recently, oldest first
+        unsigned long kept = table->num_finished < JOBS_FINISHED_KEEP ? table->num_finished : JOBS_FINISHED_KEEP;
+        for (unsigned long i = table->num_finished - kept; i < table->num_finished; i++) {
+            const finished_job_t *finished = &table->finished[i % JOBS_FINISHED_KEEP];
+            printf("[%d] %d DONE %s\n", finished->jid, finished->pid, finished->cmd_line);
+            print_job_usage(&finished->usage);
+        }
+    }
+
+    // Then the jobs waiting for a slot, in the order they will start
+    admission_queue_t *queue = shell->queue;
+    if (queue->count > 0) {
+        const queued_job_t **order = arena_alloc(shell->arena, queue->count * sizeof(queued_job_t *));
+        if (!order) return NULL;
+        sort_queued_jobs(queue, order);
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        for (int i = 0; i < queue->count; i++) {
+            double waited = (now.tv_sec - order[i]->queued_at.tv_sec) +
+                            (now.tv_nsec - order[i]->queued_at.tv_nsec) / 1e9;
+            printf("[q%d] - QUEUED %s (priority %d, waiting %.1fs)\n",
+                   i + 1, order[i]->cmd_line, order[i]->priority, waited);
+        }
+        printf("%d job(s) queued for %d slot(s)\n", queue->count, table->capacity);
+    }
+    return NULL;
+}
+
+// Command: hash [-r] [NAME...]
+static char *builtin_hash(int argc, char **argv) {
+    if (argc == 1) {
+        print_path_cache(shell->path_cache);
+    } else if (strcmp(argv[1], "-r") == 0) {
+        clear_path_cache(shell->path_cache);
+    } else {
+        for (int i = 1; i < argc; i++) { // pre-warm the cache
+            if (!resolve_path(shell->path_cache, argv[i])) {
+                fprintf(stderr, "hash: %s: not found\n", argv[i]);
+            }
+        }
+    }
+    return NULL;
+}
+
+// Command: history [-s TEXT...]
+static char *builtin_history(int argc, char **argv) {
+    if (!shell->history) {
+        fprintf(stderr, "error: history is not initialized.\n");
+    } else if (argc > 2 && strcmp(argv[1], "-s") == 0) {
+        char text[shell->max_line + 1]; // the words after -s form the search text
+        text[0] = '\0';
+        for (int i = 2; i < argc; i++) {
+            if (i > 2) strncat(text, " ", sizeof(text) - strlen(text) - 1);
+            strncat(text, argv[i], sizeof(text) - strlen(text) - 1);
+        }
+        int *matches = arena_alloc(shell->arena, shell->history->count * sizeof(int));
+        if (matches) {
+            int found = search_history(shell->history, text, false, matches, shell->history->count);
+            for (int i = found - 1; i >= 0; i--) { // oldest first, like print_history
+                printf("%5d\t%s\n", matches[i], find_line_history(shell->history, matches[i]));
+            }
+        }
+    } else {
+        print_history(shell->history);
+    }
+    return NULL;
+}
+
+// Command: !N, !prefix or !?substring (History expansion)
+static char *builtin_expand_history(int argc, char **argv) {
+    (void)argc;
+    char *cmd = NULL;
+    if (isdigit((unsigned char)argv[0][1])) {
+        int index = atoi(&argv[0][1]);
+        if (shell->history) {
+            cmd = find_line_history(shell->history, index);
+        }
+        if (!cmd) {
+            fprintf(stderr, "error: invalid or out-of-range history index\n");
+            return NULL;
+        }
+    } else if (shell->history) {
+        bool prefix = argv[0][1] != '?';
+        char *text = arena_strdup(shell->arena, &argv[0][prefix ? 1 : 2]);
+        if (!text) return NULL;
+        if (!prefix && text[0] && text[strlen(text) - 1] == '?') {
+            text[strlen(text) - 1] = '\0'; // !?text? is accepted too
+        }
+        // The newest line is this command itself, so look at the two newest matches
+        int matches[2];
+        int found = search_history(shell->history, text, prefix, matches, 2);
+        for (int i = 0; i < found && !cmd; i++) {
+            if (matches[i] != shell->history->count) {
+                cmd = find_line_history(shell->history, matches[i]);
+            }
+        }
+        if (!cmd) {
+            fprintf(stderr, "error: no history line matches %s\n", text);
+            return NULL;
+        }
+    }
+    if (cmd) {
+        printf("%s\n", cmd); // Show the command being executed
+        return arena_strdup(shell->arena, cmd); // a copy: adding it to the history may evict cmd
+    }
+    return NULL;
+}
+
+// Commands: bg %N or fg %N
+static char *builtin_fg_bg(int argc, char **argv) {
+    if (argc < 2) return NULL;
+    if (argv[1][0] == '%') {
+        int jid = atoi(&argv[1][1]); // Parse job ID
+        job_t *job = get_job_by_jid(shell->jobs, jid);
+        if (job) {
+            // Foreground jobs run at the shell's priority, background ones under MSH_BG_SCHED
+            bool background = strcmp(argv[0], "bg") == 0;
+            int err = prioritize_job(&shell->bg_policy, job, background);
+            if (err) {
+                fprintf(stderr, "%s: [%d] keeps its %s priority: %s\n", argv[0], job->jid,
+                        background ? "foreground" : "background", strerror(err));
+            }
+            kill(-job->pid, SIGCONT); // Send SIGCONT to the job's process group
+            if (strcmp(argv[0], "fg") == 0) {
+                set_job_state(shell->jobs, job, FOREGROUND);
+                waitfg(job->pid); // Wait for foreground job to complete
+            } else if (strcmp(argv[0], "bg") == 0) {
+                set_job_state(shell->jobs, job, BACKGROUND);
+                printf("[%d] %d %s\n", job->jid, job->pid, "RUNNING");
+            }
+            return NULL;
+        }
+        fprintf(stderr, "error: job ID %d not found\n", jid);
+    } else {
+        fprintf(stderr, "error: invalid job ID format. Use %%<JOB_ID>\n");
+    }
+    return NULL;
+}
+
+// Command: kill SIGNAL PID
+static char *builtin_kill(int argc, char **argv) {
+    if (argc != 3) return NULL;
+    int sig_num = atoi(argv[1]);
+    pid_t pid = atoi(argv[2]);
+
+    // Validate signal number
+    if (sig_num != SIGINT && sig_num != SIGKILL && sig_num != SIGCONT && sig_num != SIGSTOP) {
+        fprintf(stderr, "error: invalid signal number. Allowed: 2(SIGINT), 9(SIGKILL), 18(SIGCONT), 19(SIGSTOP)\n");
+        return NULL;
+    }
+
+    // A process of a job is signalled through its pidfd, so a pid reused since it was reaped is never hit
+    job_t *job = get_job_by_pid(shell->jobs, pid);
+    bool live = false;
+    for (int p = 0; job && p < job->nprocs; p++) {
+        live = live || job->procs[p] == pid;
+    }
+    int pidfd = live ? job_pidfd(job, pid) : -1;
+    int result;
+    if (job && !live) {
+        errno = ESRCH; // the group leader was reaped; its pid only names the job now
+        result = -1;
+#ifdef SYS_pidfd_send_signal
+    } else if (pidfd != -1) {
+        result = syscall(SYS_pidfd_send_signal, pidfd, sig_num, NULL, 0);
+#endif
+    } else {
+        result = kill(pid, sig_num);
+    }
+    if (result == -1) {
+        perror("kill");
+    }
+    return NULL;
+}
+
+// the exit status a wait status stands for, as the shell reports it
+static int exit_status(int status) {
+    return WIFSIGNALED(status) ? 128 + WTERMSIG(status) : WEXITSTATUS(status);
+}
+
+// A job `wait` waits for, remembered by number and process group so a reused slot is not mistaken for it
+typedef struct wait_target {
+    int jid;
+    pid_t pgid;
+} wait_target_t;
+
+// true while the target job is still running in the background
+static bool target_running(const wait_target_t *target) {
+    job_t *job = get_job_by_jid(shell->jobs, target->jid);
+    return job && job->pid == target->pgid && job->state == BACKGROUND;
+}
+
+// registers the pidfds of a job's live processes; ones already in the set are left alone
+static void watch_job(int epfd, const job_t *job) {
+    for (int p = 0; p < job->nprocs; p++) {
+        if (job->pidfds[p] == -1) continue;
+        struct epoll_event event = {.events = EPOLLIN, .data.fd = job->pidfds[p]};
+        epoll_ctl(epfd, EPOLL_CTL_ADD, job->pidfds[p], &event); // EEXIST if it is already watched
+    }
+}
+
+// Command: wait [-n] [%JOB | PID ...]
+static char *builtin_wait(int argc, char **argv) {
+    bool any = argc > 1 && strcmp(argv[1], "-n") == 0;
+    int first = any ? 2 : 1;
+    int ntargets = argc - first;
+    wait_target_t *targets = malloc((ntargets + 1) * sizeof(wait_target_t));
+    if (!targets) {
+        perror("malloc");
+        builtin_status = 1;
+        return NULL;
+    }
+
+    builtin_status = 0;
+    int n = 0;
+    for (int i = first; i < argc; i++) {
+        job_t *job = argv[i][0] == '%' ? get_job_by_jid(shell->jobs, atoi(&argv[i][1]))
+                                       : get_job_by_pid(shell->jobs, atoi(argv[i]));
+        if (job) {
+            targets[n++] = (wait_target_t){job->jid, job->pid};
+            continue;
+        }
+        const finished_job_t *finished = argv[i][0] == '%' ? NULL : get_finished_job(shell->jobs, atoi(argv[i]));
+        if (finished) { // it is already done
+            builtin_status = exit_status(finished->usage.status);
+            if (any) {
+                free(targets);
+                return NULL;
+            }
+        } else {
+            fprintf(stderr, "wait: %s: no such job\n", argv[i]);
+            builtin_status = 127;
+        }
+    }
+    if (ntargets > 0 && n == 0) { // every target had finished or does not exist
+        free(targets);
+        return NULL;
+    }
+
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd == -1) {
+        perror("epoll_create1");
+        free(targets);
+        builtin_status = 1;
+        return NULL;
+    }
+    struct epoll_event signal_event = {.events = EPOLLIN, .data.fd = signal_event_fd()};
+    epoll_ctl(epfd, EPOLL_CTL_ADD, signal_event_fd(), &signal_event);
+
+    take_interrupt(); // a stale Ctrl+C must not end this wait
+    unsigned long finished_before = shell->jobs->num_finished;
+    for (;;) {
+        // With no targets, every background job (and every queued one, as it is admitted) is waited for
+        bool running = false, done = false;
+        if (n == 0) {
+            for (int i = 0; i < shell->jobs->capacity; i++) {
+                job_t *job = &shell->jobs->jobs[i];
+                if (job->state != BACKGROUND) continue;
+                running = true;
+                watch_job(epfd, job);
+            }
+            running = running || shell->queue->count > 0;
+            if (any && shell->jobs->num_finished != finished_before) {
+                const finished_job_t *finished =
+                    &shell->jobs->finished[(shell->jobs->num_finished - 1) % JOBS_FINISHED_KEEP];
+                builtin_status = exit_status(finished->usage.status);
+                done = true;
+            } else if (any && !running) {
+                builtin_status = 127; // no job to wait for
+                done = true;
+            } else {
+                done = !running;
+            }
+        } else {
+            for (int t = 0; t < n && !done; t++) {
+                if (target_running(&targets[t])) {
+                    running = true;
+                    watch_job(epfd, get_job_by_jid(shell->jobs, targets[t].jid));
+                } else {
+                    const finished_job_t *finished = get_finished_job(shell->jobs, targets[t].pgid);
+                    if (finished) builtin_status = exit_status(finished->usage.status);
+                    if (any) done = true; // a stopped job also ends wait -n
+                }
+            }
+            done = done || !running;
+        }
+        if (done) break;
+
+        struct epoll_event events[16];
+        int ready = epoll_wait(epfd, events, 16, -1);
+        if (ready == -1 && errno != EINTR) {
+            perror("epoll_wait");
+            builtin_status = 1;
+            break;
+        }
+        bool exited = false;
+        for (int i = 0; i < ready; i++) {
+            if (events[i].data.fd == signal_event_fd()) handle_signal_events();
+            else exited = true;
+        }
+        if (exited) reap_children(); // no need to wait for the SIGCHLD
+        if (take_interrupt()) {
+            builtin_status = 128 + SIGINT;
+            break;
+        }
+        admit_queued_jobs(shell);
+    }
+    close(epfd);
+    free(targets);
+    return NULL;
+}
+
+// Command: set [-b | +b]
+static char *builtin_set(int argc, char **argv) {
+    builtin_status = 0;
+    if (argc == 1) { // show the options
+        printf("set %cb\n", shell->notify_now ? '-' : '+');
+        return NULL;
+    }
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-b") == 0) { // report finished background jobs at once
+            shell->notify_now = true;
+            shell->jobs->notify = true;
+            report_completions(shell); // the ones already waiting for the prompt
+        } else if (strcmp(argv[i], "+b") == 0) { // report them at the next prompt
+            shell->notify_now = false;
+        } else {
+            fprintf(stderr, "set: %s: invalid option\nusage: set [-b | +b]\n", argv[i]);
+            builtin_status = 2;
+        }
+    }
+    return NULL;
+}
+
+// The builtin registry: a new builtin only needs its handler and a line here
+static const builtin_t BUILTINS[] = {
+    {"jobs",    builtin_jobs,           BUILTIN_IN_PIPELINE},
+    {"history", builtin_history,        BUILTIN_IN_PIPELINE},
+    {"hash",    builtin_hash,           BUILTIN_IN_PIPELINE},
+    {"kill",    builtin_kill,           BUILTIN_IN_PIPELINE},
+    {"bg",      builtin_fg_bg,          0},
+    {"fg",      builtin_fg_bg,          0},
+    {"wait",    builtin_wait,           0},
+    {"set",     builtin_set,            0},
+    {"!",       builtin_expand_history, 0},
+    {"parallel", builtin_parallel,      0},
+    {"stats",   builtin_stats,          BUILTIN_IN_PIPELINE},
+    {"echo",    utility_echo,           BUILTIN_IN_PIPELINE | BUILTIN_UTILITY},
+    {"true",    utility_true,           BUILTIN_IN_PIPELINE | BUILTIN_UTILITY},
+    {"false",   utility_false,          BUILTIN_IN_PIPELINE | BUILTIN_UTILITY},
+    {"test",    utility_test,           BUILTIN_IN_PIPELINE | BUILTIN_UTILITY},
+    {"[",       utility_test,           BUILTIN_IN_PIPELINE | BUILTIN_UTILITY},
+    {"printf",  utility_printf,         BUILTIN_IN_PIPELINE | BUILTIN_UTILITY},
+    {"pwd",     utility_pwd,            BUILTIN_IN_PIPELINE | BUILTIN_UTILITY},
+};
+#define NUM_BUILTINS (int)(sizeof(BUILTINS) / sizeof(BUILTINS[0]))
+_Static_assert(NUM_BUILTINS < BUILTIN_SLOTS && NUM_BUILTINS < 256, "too many builtins for BUILTIN_SLOTS");
+
+int builtin_status = 0;
+
+// SLOTS[hash_builtin_name(name, BUILTIN_SEED)] is the registry index + 1 of the builtin called name, or 0.
+// Adding or renaming a builtin means updating this table; tests/test_builtins prints the new one.
+static const unsigned char SLOTS[BUILTIN_SLOTS] = {
+    [0]  = 8,   // set
+    [1]  = 14,  // false
+    [3]  = 7,   // wait
+    [5]  = 16,  // [
+    [6]  = 10,  // parallel
+    [10] = 4,   // kill
+    [12] = 6,   // fg
+    [20] = 1,   // jobs
+    [27] = 5,   // bg
+    [32] = 11,  // stats
+    [35] = 2,   // history
+    [36] = 13,  // true
+    [39] = 3,   // hash
+    [40] = 17,  // printf
+    [47] = 18,  // pwd
+    [49] = 15,  // test
+    [54] = 9,   // !
+    [59] = 12,  // echo
+};
+
+unsigned int hash_builtin_name(const char *name, unsigned int seed) {
+    unsigned int hash = 2166136261u ^ seed;
+    for (; *name; name++) {
+        hash = (hash ^ (unsigned char)*name) * 16777619u; // FNV-1a
+    }
+    return (hash ^ (hash >> 15)) & (BUILTIN_SLOTS - 1);
+}
+
+const builtin_t *builtin_registry(int *count) {
+    *count = NUM_BUILTINS;
+    return BUILTINS;
+}
+
+const builtin_t *find_builtin(const char *name) {
+    if (name[0] == '!') {
+        if (name[1] == '\0') return NULL; // a lone ! is not an expansion
+        name = "!";
+    }
+    int index = SLOTS[hash_builtin_name(name, BUILTIN_SEED)];
+    if (index && strcmp(BUILTINS[index - 1].name, name) == 0) {
+        return &BUILTINS[index - 1];
+    }
+    return NULL;
+}
+
+char *builtin_cmd(int argc, char **argv) {
+    if (argc == 0) return NULL;
+    const builtin_t *builtin = find_builtin(argv[0]);
+    return builtin ? builtin->handler(argc, argv) : NULL;
+}
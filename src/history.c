@@ -1,13 +1,76 @@
 #include "history.h"
+#include "intern.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdbool.h>
+#include <fcntl.h>      // For open
+#include <unistd.h>     // For write, fsync
+#include <sys/mman.h>   // For mmap
+#include <sys/stat.h>   // For fstat
+#include <sys/uio.h>    // For writev
 
 const char *HISTORY_FILE_PATH = "../data/.msh_history";
 
+/*
+ * load_history_tail: Loads the newest max_history lines of the journal into the history.
+ * The journal is mmap'd and scanned backwards from its end, so startup cost depends on the
+ * number of lines kept rather than on the size of the file, and lines may be of any length.
+ */
+static void load_history_tail(history_t *history) {
+    struct stat st;
+    if (fstat(history->fd, &st) == -1 || st.st_size == 0) return;
+    history->file_size = st.st_size;
+
+    char *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, history->fd, 0);
+    if (data == MAP_FAILED) {
+        perror("mmap");
+        return;
+    }
+
+    // Walk backwards collecting line boundaries until max_history non-empty lines are found
+    off_t end = st.st_size;
+    if (data[end - 1] == '\n') end--; // ignore the final newline
+    off_t first = end;                 // start of the oldest line that will be kept
+    int found = 0;
+    off_t pos = end;
+    while (pos > 0 && found < history->max_history) {
+        off_t line_end = pos;
+        while (pos > 0 && data[pos - 1] != '\n') pos--;
+        if (line_end > pos) {
+            found++;
+            first = pos;
+        }
+        if (pos > 0) pos--; // step over the newline before this line
+    }
+
+    // Copy the lines oldest first
+    off_t cur = first;
+    while (cur < end && history->count < found) {
+        char *nl = memchr(data + cur, '\n', end - cur);
+        off_t line_end = nl ? nl - data : end;
+        if (line_end > cur) {
+            char *line = intern_string_len(data + cur, line_end - cur);
+            if (!line) break;
+            history->lines[history->count++] = line;
+            index_history_line(history->index, line, history->next_seq++);
+        }
+        cur = line_end + 1;
+    }
+    history->live_size = st.st_size - first;
+
+    bool unterminated = data[st.st_size - 1] != '\n';
+    munmap(data, st.st_size);
+
+    if (unterminated && write(history->fd, "\n", 1) == 1) { // keep the next append on its own line
+        history->file_size++;
+        history->live_size++;
+    }
+}
+
 /*
  * alloc_history: Allocates and initializes a history_t structure.
- * Loads prior history from the file into the lines array.
+ * Opens the history journal and loads the newest lines from it.
  *
  * max_history: Maximum number of history lines.
  *
@@ -28,53 +91,122 @@ history_t *alloc_history(int max_history) {
     }
 
     history->max_history = max_history;
-    history->next = 0;
-
-    // Open the history file to load prior history
-    FILE *file = fopen(HISTORY_FILE_PATH, "r");
-    if (file) {
-        char buffer[1024];
-        while (fgets(buffer, sizeof(buffer), file)) {
-            size_t len = strlen(buffer);
-            if (len > 0 && buffer[len - 1] == '\n') {
-                buffer[len - 1] = '\0'; // Remove trailing newline
-            }
+    history->start = 0;
+    history->count = 0;
+    history->file_size = 0;
+    history->live_size = 0;
+    history->unsynced = 0;
+    history->next_seq = 0;
 
-            // Add the line to the history
-            if (history->next < max_history) {
-                history->lines[history->next] = strdup(buffer);
-                history->next++;
-            }
-        }
-        fclose(file);
+    history->index = alloc_history_index();
+    if (!history->index) {
+        free(history->lines);
+        free(history);
+        return NULL;
+    }
+
+    // Open (or create) the journal; without it the history is kept in memory only
+    history->fd = open(HISTORY_FILE_PATH, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (history->fd != -1) {
+        load_history_tail(history);
     }
 
     return history;
 }
 
+// maps a 0-based position in the history (0 = oldest) to its slot in the circular buffer
+static int history_slot(const history_t *history, int pos) {
+    int slot = history->start + pos;
+    return slot >= history->max_history ? slot - history->max_history : slot;
+}
+
 /*
- * add_line_history: Adds a command line to the history.
+ * compact_history: Rewrites the journal so it holds exactly the lines in the history.
+ * The new journal is written to a temporary file and renamed over the old one, so a crash
+ * in the middle leaves either the old or the new journal intact.
+ */
+static void compact_history(history_t *history) {
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", HISTORY_FILE_PATH);
+
+    FILE *file = fopen(tmp_path, "w");
+    if (!file) return; // keep appending to the old journal
+    for (int i = 0; i < history->count; i++) {
+        fprintf(file, "%s\n", history->lines[history_slot(history, i)]);
+    }
+    if (fflush(file) != 0 || fsync(fileno(file)) == -1) {
+        fclose(file);
+        remove(tmp_path);
+        return;
+    }
+    fclose(file);
+
+    if (rename(tmp_path, HISTORY_FILE_PATH) == -1) {
+        remove(tmp_path);
+        return;
+    }
+    close(history->fd);
+    history->fd = open(HISTORY_FILE_PATH, O_RDWR | O_APPEND | O_CLOEXEC);
+    history->file_size = history->live_size;
+    history->unsynced = 0;
+}
+
+// appends one line to the journal, syncing every HISTORY_FSYNC_BATCH lines
+static void append_history(history_t *history, const char *line, size_t len) {
+    if (history->fd == -1) return;
+
+    struct iovec iov[2] = {
+        { .iov_base = (void *)line, .iov_len = len },
+        { .iov_base = "\n", .iov_len = 1 },
+    };
+    ssize_t written = writev(history->fd, iov, 2); // one O_APPEND write keeps the line whole
+    if (written > 0) {
+        history->file_size += written;
+    }
+    if (++history->unsynced >= HISTORY_FSYNC_BATCH) {
+        fdatasync(history->fd);
+        history->unsynced = 0;
+    }
+
+    if (history->file_size > HISTORY_COMPACT_MIN_BYTES &&
+        history->file_size > HISTORY_COMPACT_FACTOR * history->live_size) {
+        compact_history(history);
+    }
+}
+
+/*
+ * add_line_history: Adds a command line to the history and appends it to the journal.
+ * Once the history is full the oldest line is overwritten in place, so adding is O(1).
  * 
  * history: Pointer to the history structure.
  * cmd_line: The command line to add.
  */
 void add_line_history(history_t *history, const char *cmd_line) {
-    if (!cmd_line || strlen(cmd_line) == 0 || strcmp(cmd_line, "exit") == 0) {
+    if (!cmd_line || cmd_line[0] == '\0' || strcmp(cmd_line, "exit") == 0) {
         return; // Do not add empty or "exit" commands
     }
 
-    // If the history is full, remove the oldest entry
-    if (history->next == history->max_history) {
-        free(history->lines[0]);
-        for (int i = 1; i < history->max_history; i++) {
-            history->lines[i - 1] = history->lines[i];
-        }
-        history->next--;
+    size_t len = strlen(cmd_line);
+    char *line = intern_string(cmd_line); // shared with the jobs it starts and repeated lines
+    if (!line) return;
+
+    if (history->count == history->max_history) {
+        // If the history is full, replace the oldest entry and advance the start
+        char *oldest = history->lines[history->start];
+        history->live_size -= strlen(oldest) + 1;
+        unindex_history_line(history->index, oldest, history->next_seq - history->count + 1);
+        release_string(oldest);
+        history->lines[history->start] = line;
+        history->start = history_slot(history, 1);
+    } else {
+        // Add the new command to the history
+        history->lines[history_slot(history, history->count)] = line;
+        history->count++;
     }
+    history->live_size += len + 1;
+    index_history_line(history->index, line, history->next_seq++);
 
-    // Add the new command to the history
-    history->lines[history->next] = strdup(cmd_line);
-    history->next++;
+    append_history(history, line, len);
 }
 
 /*
@@ -83,8 +215,8 @@ void add_line_history(history_t *history, const char *cmd_line) {
  * history: Pointer to the history structure.
  */
 void print_history(history_t *history) {
-    for (int i = 1; i <= history->next; i++) {
-        printf("%5d\t%s\n", i, history->lines[i - 1]);
+    for (int i = 1; i <= history->count; i++) {
+        printf("%5d\t%s\n", i, history->lines[history_slot(history, i - 1)]);
     }
 }
 
@@ -97,31 +229,79 @@ void print_history(history_t *history) {
  * Returns: The command line at the given index or NULL if the index is invalid.
  */
 char *find_line_history(history_t *history, int index) {
-    if (index < 1 || index > history->next) {
+    if (index < 1 || index > history->count) {
         return NULL;
     }
-    return history->lines[index - 1];
+    return history->lines[history_slot(history, index - 1)];
+}
+
+// checks a history line against a search query
+static bool line_matches(const char *line, const char *text, size_t len, bool prefix) {
+    return prefix ? strncmp(line, text, len) == 0 : strstr(line, text) != NULL;
+}
+
+/*
+ * search_history: Finds the history lines that contain text, or that start with it.
+ * Candidates come from the rarest trigram of the query in the index, so the cost depends on how
+ * common the query is rather than on the size of the history. Queries too short to have a trigram
+ * fall back to a linear scan.
+ *
+ * history: Pointer to the history structure.
+ * text: The text to search for.
+ * prefix: true to match only lines starting with text (`!prefix`), false for substrings (`!?text`).
+ * matches: Receives the 1-based history numbers of the matches, newest first.
+ * max_matches: The capacity of matches.
+ *
+ * Returns: The number of matches stored in matches.
+ */
+int search_history(history_t *history, const char *text, bool prefix, int *matches, int max_matches) {
+    size_t len = strlen(text);
+    unsigned int oldest_seq = history->next_seq - history->count;
+    int found = 0;
+
+    const posting_list_t *candidates;
+    if (!history_index_candidates(history->index, text, prefix, &candidates)) {
+        for (int i = history->count; i >= 1 && found < max_matches; i--) { // linear scan
+            if (line_matches(find_line_history(history, i), text, len, prefix)) {
+                matches[found++] = i;
+            }
+        }
+        return found;
+    }
+
+    if (!candidates) return 0; // some trigram of the query never occurs
+    for (unsigned int c = candidates->len; c > 0 && found < max_matches; c--) {
+        unsigned int seq = candidates->seqs[c - 1];
+        if (seq < oldest_seq) break; // the rest belong to evicted lines
+        int number = seq - oldest_seq + 1;
+        if (line_matches(find_line_history(history, number), text, len, prefix)) {
+            matches[found++] = number;
+        }
+    }
+    return found;
 }
 
 /*
- * free_history: Frees the allocated history structure and writes history to the file.
+ * free_history: Flushes the journal and frees the allocated history structure.
+ * The journal is compacted if it holds lines that are no longer in the history.
  * 
  * history: Pointer to the history structure.
  */
 void free_history(history_t *history) {
-    // Write history to the file before freeing
-    FILE *file = fopen(HISTORY_FILE_PATH, "w");
-    if (file) {
-        for (int i = 0; i < history->next; i++) {
-            fprintf(file, "%s\n", history->lines[i]);
+    if (history->fd != -1) {
+        if (history->file_size > history->live_size) {
+            compact_history(history);
+        } else if (history->unsynced > 0) {
+            fdatasync(history->fd);
         }
-        fclose(file);
+        if (history->fd != -1) close(history->fd);
     }
 
     // Free the lines and the history structure
-    for (int i = 0; i < history->next; i++) {
-        free(history->lines[i]);
+    for (int i = 0; i < history->count; i++) {
+        release_string(history->lines[i]);
     }
     free(history->lines);
+    free_history_index(history->index);
     free(history);
 }
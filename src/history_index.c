@@ -0,0 +1,151 @@
+#include "history_index.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// packs three characters into a 24-bit trigram key
+static unsigned int pack_gram(const char *s) {
+    return ((unsigned char)s[0] << 16) | ((unsigned char)s[1] << 8) | (unsigned char)s[2];
+}
+
+static unsigned int hash_gram(unsigned int gram) {
+    return gram * 2654435761u; // Knuth's multiplicative hash
+}
+
+history_index_t *alloc_history_index(void) {
+    history_index_t *index = malloc(sizeof(history_index_t));
+    if (!index) {
+        perror("malloc");
+        return NULL;
+    }
+    index->slots = calloc(HISTORY_INDEX_SLOTS, sizeof(posting_list_t));
+    if (!index->slots) {
+        perror("calloc");
+        free(index);
+        return NULL;
+    }
+    index->num_slots = HISTORY_INDEX_SLOTS;
+    index->used = 0;
+    index->live_postings = 0;
+    index->stale_postings = 0;
+    return index;
+}
+
+// finds the slot of a trigram, or the empty slot where it would go
+static posting_list_t *find_slot(posting_list_t *slots, unsigned int num_slots, unsigned int gram) {
+    unsigned int mask = num_slots - 1;
+    unsigned int i = hash_gram(gram) & mask;
+    while (slots[i].gram != 0 && slots[i].gram != gram) {
+        i = (i + 1) & mask; // linear probing
+    }
+    return &slots[i];
+}
+
+// doubles the table once it is more than half full
+static void grow_index(history_index_t *index) {
+    unsigned int num_slots = index->num_slots * 2;
+    posting_list_t *slots = calloc(num_slots, sizeof(posting_list_t));
+    if (!slots) return; // probing just gets longer
+
+    for (unsigned int i = 0; i < index->num_slots; i++) {
+        if (index->slots[i].gram != 0) {
+            *find_slot(slots, num_slots, index->slots[i].gram) = index->slots[i];
+        }
+    }
+    free(index->slots);
+    index->slots = slots;
+    index->num_slots = num_slots;
+}
+
+// drops the entries of evicted lines from every posting list
+static void sweep_index(history_index_t *index, unsigned int oldest_seq) {
+    for (unsigned int i = 0; i < index->num_slots; i++) {
+        posting_list_t *list = &index->slots[i];
+        if (list->gram == 0) continue;
+        unsigned int stale = 0;
+        while (stale < list->len && list->seqs[stale] < oldest_seq) stale++;
+        list->len -= stale;
+        memmove(list->seqs, list->seqs + stale, list->len * sizeof(unsigned int));
+    }
+    index->stale_postings = 0;
+}
+
+static void add_posting(history_index_t *index, unsigned int gram, unsigned int seq) {
+    posting_list_t *list = find_slot(index->slots, index->num_slots, gram);
+    if (list->gram == 0) {
+        list->gram = gram;
+        index->used++;
+    }
+    if (list->len > 0 && list->seqs[list->len - 1] == seq) return; // repeated within the line
+
+    if (list->len == list->cap) {
+        unsigned int cap = list->cap ? list->cap * 2 : 4;
+        unsigned int *seqs = realloc(list->seqs, cap * sizeof(unsigned int));
+        if (!seqs) return;
+        list->seqs = seqs;
+        list->cap = cap;
+    }
+    list->seqs[list->len++] = seq;
+    index->live_postings++;
+
+    if (index->used * 2 > index->num_slots) {
+        grow_index(index);
+    }
+}
+
+void index_history_line(history_index_t *index, const char *line, unsigned int seq) {
+    // Pad the start so that every prefix of one or two characters also forms a trigram
+    char gram[3] = { HISTORY_INDEX_PAD[0], HISTORY_INDEX_PAD[1], '\0' };
+    for (const char *c = line; *c; c++) {
+        gram[2] = *c;
+        add_posting(index, pack_gram(gram), seq);
+        gram[0] = gram[1];
+        gram[1] = gram[2];
+    }
+}
+
+void unindex_history_line(history_index_t *index, const char *line, unsigned int oldest_seq) {
+    unsigned long grams = strlen(line); // upper bound on the entries the line added
+    if (grams > index->live_postings) grams = index->live_postings;
+    index->live_postings -= grams;
+    index->stale_postings += grams;
+
+    if (index->stale_postings > index->live_postings) {
+        sweep_index(index, oldest_seq);
+    }
+}
+
+bool history_index_candidates(history_index_t *index, const char *text, bool prefix,
+                              const posting_list_t **candidates) {
+    char query[4096];
+    size_t len = strlen(text);
+    size_t pad = prefix ? strlen(HISTORY_INDEX_PAD) : 0;
+    if (len + pad < 3 || len + pad >= sizeof(query)) return false;
+
+    memcpy(query, HISTORY_INDEX_PAD, pad);
+    memcpy(query + pad, text, len + 1);
+    len += pad;
+
+    // Every line that matches contains all trigrams of the query; the rarest one bounds the search
+    const posting_list_t *best = NULL;
+    for (size_t i = 0; i + 3 <= len; i++) {
+        posting_list_t *list = find_slot(index->slots, index->num_slots, pack_gram(query + i));
+        if (list->gram == 0 || list->len == 0) {
+            *candidates = NULL;
+            return true;
+        }
+        if (!best || list->len < best->len) {
+            best = list;
+        }
+    }
+    *candidates = best;
+    return true;
+}
+
+void free_history_index(history_index_t *index) {
+    for (unsigned int i = 0; i < index->num_slots; i++) {
+        free(index->slots[i].seqs);
+    }
+    free(index->slots);
+    free(index);
+}
@@ -0,0 +1,103 @@
+#include "intern.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+// A pooled string, with its header in the same allocation
+typedef struct interned {
+    struct interned *next;  // Next string in the same bucket
+    unsigned int hash;      // djb2 hash of the string
+    unsigned int refs;      // Number of holders
+    size_t len;             // Length of the string
+    char str[];             // The string itself
+} interned_t;
+
+// The pool is shared by everything in the shell that keeps strings around
+static interned_t **buckets = NULL;
+static size_t num_buckets = 0;
+static size_t num_strings = 0;
+static size_t num_refs = 0;
+
+static unsigned int hash_string(const char *s, size_t len) {
+    unsigned int hash = 5381;
+    for (size_t i = 0; i < len; i++) {
+        hash = hash * 33 + (unsigned char)s[i]; // djb2
+    }
+    return hash;
+}
+
+// doubles the number of buckets once the pool holds more strings than buckets
+static void grow_pool(void) {
+    size_t size = num_buckets ? num_buckets * 2 : INTERN_BUCKETS;
+    interned_t **grown = calloc(size, sizeof(interned_t *));
+    if (!grown) {
+        if (!buckets) perror("calloc");
+        return; // with a pool in place, chains just get longer
+    }
+    for (size_t b = 0; b < num_buckets; b++) {
+        interned_t *entry = buckets[b];
+        while (entry) {
+            interned_t *next = entry->next;
+            entry->next = grown[entry->hash & (size - 1)];
+            grown[entry->hash & (size - 1)] = entry;
+            entry = next;
+        }
+    }
+    free(buckets);
+    buckets = grown;
+    num_buckets = size;
+}
+
+char *intern_string_len(const char *s, size_t len) {
+    if (num_strings >= num_buckets) grow_pool();
+    if (!buckets) return NULL;
+
+    unsigned int hash = hash_string(s, len);
+    interned_t **bucket = &buckets[hash & (num_buckets - 1)];
+    for (interned_t *entry = *bucket; entry; entry = entry->next) {
+        if (entry->hash == hash && entry->len == len && memcmp(entry->str, s, len) == 0) {
+            entry->refs++;
+            num_refs++;
+            return entry->str;
+        }
+    }
+
+    interned_t *entry = malloc(sizeof(interned_t) + len + 1);
+    if (!entry) {
+        perror("malloc");
+        return NULL;
+    }
+    entry->hash = hash;
+    entry->refs = 1;
+    entry->len = len;
+    memcpy(entry->str, s, len);
+    entry->str[len] = '\0';
+    entry->next = *bucket;
+    *bucket = entry;
+    num_strings++;
+    num_refs++;
+    return entry->str;
+}
+
+char *intern_string(const char *s) {
+    return intern_string_len(s, strlen(s));
+}
+
+void release_string(char *s) {
+    if (!s) return;
+    interned_t *entry = (interned_t *)(s - offsetof(interned_t, str));
+    num_refs--;
+    if (--entry->refs > 0) return;
+
+    interned_t **link = &buckets[entry->hash & (num_buckets - 1)];
+    while (*link != entry) link = &(*link)->next;
+    *link = entry->next;
+    free(entry);
+    num_strings--;
+}
+
+void intern_stats(size_t *strings, size_t *references) {
+    *strings = num_strings;
+    *references = num_refs;
+}
@@ -1,60 +1,385 @@
 #include "job.h"
+#include "intern.h"
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/time.h> // For timeradd
+#include <sys/syscall.h> // For SYS_pidfd_open
+#include <unistd.h>
 
-// adds job to job list
-bool add_job(job_t *jobs, int max_jobs, pid_t pid, job_state_t state, const char *cmd_line) {
-    for (int i = 0; i < max_jobs; i++) {
-        if (jobs[i].state == UNDEFINED) { // find first undefined job slot
-            jobs[i].pid = pid; // set job pid
-            jobs[i].state = state; // set job state
-            jobs[i].jid = i + 1; // assign job id
-            jobs[i].cmd_line = strdup(cmd_line); // duplicate command line
-            return true; // return true if job added successfully
+// The pid index is kept at most half full so probes stay short
+#define PID_INDEX_MIN 64
+
+static unsigned int hash_pid(pid_t pid) {
+    return (unsigned int)pid * 2654435761u; // Knuth's multiplicative hash
+}
+
+// finds the entry of pid, or the empty entry where it would go
+static pid_slot_t *find_pid(pid_slot_t *pids, int capacity, pid_t pid) {
+    unsigned int mask = capacity - 1;
+    unsigned int i = hash_pid(pid) & mask;
+    while (pids[i].pid != 0 && pids[i].pid != pid) {
+        i = (i + 1) & mask; // linear probing
+    }
+    return &pids[i];
+}
+
+// maps pid to slot; the index must have room (see reserve_pids)
+static void index_pid(job_table_t *table, pid_t pid, int slot) {
+    pid_slot_t *entry = find_pid(table->pids, table->pid_capacity, pid);
+    if (entry->pid == 0) {
+        entry->pid = pid;
+        table->pid_count++;
+    }
+    entry->slot = slot;
+}
+
+// removes pid from the index without leaving tombstones (backward-shift deletion)
+static void unindex_pid(job_table_t *table, pid_t pid) {
+    unsigned int mask = table->pid_capacity - 1;
+    pid_slot_t *entry = find_pid(table->pids, table->pid_capacity, pid);
+    if (entry->pid == 0) return;
+    table->pid_count--;
+
+    unsigned int hole = entry - table->pids;
+    unsigned int i = hole;
+    for (;;) {
+        i = (i + 1) & mask;
+        if (table->pids[i].pid == 0) break;
+        unsigned int home = hash_pid(table->pids[i].pid) & mask;
+        // entry i may move into the hole only if its home is not cyclically in (hole, i]
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            table->pids[hole] = table->pids[i];
+            hole = i;
         }
     }
-    return false; // return false if no available slot for job
+    table->pids[hole].pid = 0;
 }
 
-// deletes job from job list
-bool delete_job(job_t *jobs, int max_jobs, pid_t pid) {
-    for (int i = 0; i < max_jobs; i++) {
-        if (jobs[i].pid == pid) { // find job with matching pid
-            free(jobs[i].cmd_line); // free command line memory
-            jobs[i].state = UNDEFINED; // set job state to undefined
-            jobs[i].pid = -1; // reset pid
-            jobs[i].jid = 0; // reset job id
-            return true; // return true if job deleted successfully
+// makes room in the pid index for extra more entries, so the reaping path never allocates
+static bool reserve_pids(job_table_t *table, int extra) {
+    int needed = (table->pid_count + extra) * 2;
+    if (needed <= table->pid_capacity) return true;
+
+    int capacity = table->pid_capacity;
+    while (capacity < needed) capacity *= 2;
+    pid_slot_t *pids = calloc(capacity, sizeof(pid_slot_t));
+    if (!pids) {
+        perror("calloc");
+        return false;
+    }
+    for (int i = 0; i < table->pid_capacity; i++) {
+        if (table->pids[i].pid != 0) {
+            *find_pid(pids, capacity, table->pids[i].pid) = table->pids[i];
         }
     }
-    return false; // return false if job not found
+    free(table->pids);
+    table->pids = pids;
+    table->pid_capacity = capacity;
+    return true;
+}
+
+// opens a pidfd for pid, which stays valid across pid reuse; -1 where the kernel has no pidfds
+static int open_pidfd(pid_t pid) {
+#ifdef SYS_pidfd_open
+    return syscall(SYS_pidfd_open, pid, 0); // close-on-exec; valid for an unreaped child even once it exits
+#else
+    (void)pid;
+    return -1;
+#endif
+}
+
+// closes the pidfds of a job's live processes
+static void close_pidfds(job_t *job) {
+    for (int p = 0; p < job->nprocs; p++) {
+        if (job->pidfds[p] != -1) close(job->pidfds[p]);
+    }
 }
 
-job_t *get_job_by_pid(job_t *jobs, int max_jobs, pid_t pid) {
-    for (int i = 0; i < max_jobs; i++) {
-        if (jobs[i].pid == pid) {
-            return &jobs[i];
+// doubles the number of job slots
+static bool grow_jobs(job_table_t *table) {
+    int capacity = table->capacity * 2;
+    job_t *jobs = realloc(table->jobs, capacity * sizeof(job_t));
+    if (!jobs) {
+        perror("realloc");
+        return false;
+    }
+    table->jobs = jobs;
+    int words = (capacity + 63) / 64;
+    uint64_t *used = realloc(table->used, words * sizeof(uint64_t));
+    if (!used) {
+        perror("realloc");
+        return false;
+    }
+    int old_words = (table->capacity + 63) / 64;
+    memset(used + old_words, 0, (words - old_words) * sizeof(uint64_t));
+    table->used = used;
+
+    for (int i = table->capacity; i < capacity; i++) { // mark every new slot as free
+        jobs[i].state = UNDEFINED;
+        jobs[i].pid = -1;
+        jobs[i].jid = 0;
+    }
+    table->capacity = capacity;
+    return true;
+}
+
+// returns the lowest free slot, or -1 if every slot is taken
+static int free_slot(job_table_t *table) {
+    int words = (table->capacity + 63) / 64;
+    for (int w = 0; w < words; w++) {
+        if (~table->used[w] != 0) {
+            int slot = w * 64 + __builtin_ctzll(~table->used[w]);
+            return slot < table->capacity ? slot : -1;
         }
     }
-    return NULL;
+    return -1;
+}
+
+job_table_t *alloc_jobs(int max_jobs, bool grow) {
+    job_table_t *table = calloc(1, sizeof(job_table_t));
+    if (!table) {
+        perror("calloc");
+        return NULL;
+    }
+    table->jobs = malloc(max_jobs * sizeof(job_t));
+    table->used = calloc((max_jobs + 63) / 64, sizeof(uint64_t));
+    table->pid_capacity = PID_INDEX_MIN;
+    table->pids = calloc(table->pid_capacity, sizeof(pid_slot_t));
+    if (!table->jobs || !table->used || !table->pids) {
+        perror("calloc");
+        free_jobs(table);
+        return NULL;
+    }
+    for (int i = 0; i < max_jobs; i++) { // mark every slot as free
+        table->jobs[i].state = UNDEFINED;
+        table->jobs[i].pid = -1;
+        table->jobs[i].jid = 0;
+    }
+    table->capacity = max_jobs;
+    table->max_jobs = max_jobs;
+    table->grow = grow;
+    table->fg_slot = -1;
+    return table;
+}
+
+job_t *get_job_by_pid(job_table_t *table, pid_t pid) {
+    if (pid <= 0) return NULL;
+    pid_slot_t *entry = find_pid(table->pids, table->pid_capacity, pid);
+    return entry->pid == 0 ? NULL : &table->jobs[entry->slot];
+}
+
+job_t *get_job_by_jid(job_table_t *table, int jid) {
+    if (jid < 1 || jid > table->capacity) return NULL;
+    job_t *job = &table->jobs[jid - 1];
+    return job->state == UNDEFINED ? NULL : job;
+}
+
+job_t *get_foreground_job(job_table_t *table) {
+    return table->fg_slot < 0 ? NULL : &table->jobs[table->fg_slot];
+}
+
+void set_job_state(job_table_t *table, job_t *job, job_state_t state) {
+    int slot = job - table->jobs;
+    if (state == FOREGROUND) {
+        table->fg_slot = slot;
+    } else if (table->fg_slot == slot) {
+        table->fg_slot = -1;
+    }
+    job->state = state;
+}
+
+bool job_table_full(const job_table_t *table) {
+    return !table->grow && table->count >= table->capacity;
+}
+
+// adds job to job list
+bool add_job(job_table_t *table, pid_t pgid, const pid_t *procs, int nprocs,
+             job_state_t state, const char *cmd_line) {
+    int slot = free_slot(table);
+    if (slot == -1) { // every slot is taken
+        if (!table->grow || !grow_jobs(table)) return false;
+        slot = free_slot(table);
+    }
+    if (!reserve_pids(table, nprocs + 1)) return false;
+
+    job_t *job = &table->jobs[slot];
+    char *interned = intern_string(cmd_line); // usually the history already holds this line
+    if (!interned) return false; // completions and jobs expect every job to have its command line
+    job->procs = malloc(nprocs * sizeof(pid_t)); // copy the pids of every stage
+    job->pidfds = malloc(nprocs * sizeof(int));
+    if (!job->procs || !job->pidfds) {
+        free(job->procs);
+        free(job->pidfds);
+        job->procs = NULL;
+        job->pidfds = NULL;
+        release_string(interned);
+        return false;
+    }
+    memcpy(job->procs, procs, nprocs * sizeof(pid_t));
+    for (int p = 0; p < nprocs; p++) {
+        job->pidfds[p] = open_pidfd(procs[p]);
+    }
+    job->cmd_line = interned;
+    job->nprocs = nprocs;
+    job->nlive = nprocs;
+    memset(&job->usage, 0, sizeof(job->usage));
+    job->silent = false;
+    job->pinned = false;
+    clock_gettime(CLOCK_MONOTONIC, &job->usage.start);
+    job->pid = pgid; // set job process group
+    job->jid = slot + 1; // assign job id
+    job->state = UNDEFINED;
+    set_job_state(table, job, state);
+
+    table->used[slot / 64] |= 1ULL << (slot % 64);
+    table->count++;
+    index_pid(table, pgid, slot);
+    for (int p = 0; p < nprocs; p++) {
+        index_pid(table, procs[p], slot);
+    }
+    return true;
+}
+
+// queues the notice of a finished background job; the notice is dropped if there is no memory for it
+static void queue_completion(job_table_t *table, const job_t *job) {
+    if (table->num_completions == table->completions_capacity) {
+        int capacity = table->completions_capacity ? table->completions_capacity * 2 : 16;
+        completion_t *completions = realloc(table->completions, capacity * sizeof(completion_t));
+        if (!completions) return;
+        table->completions = completions;
+        table->completions_capacity = capacity;
+    }
+    completion_t *completion = &table->completions[table->num_completions++];
+    completion->cmd_line = intern_string(job->cmd_line); // another reference to the same string
+    completion->pid = job->pid;
+    completion->jid = job->jid;
+}
+
+void clear_completions(job_table_t *table) {
+    for (int i = 0; i < table->num_completions; i++) {
+        release_string(table->completions[i].cmd_line);
+    }
+    table->num_completions = 0;
 }
 
-job_t *get_foreground_job(job_t *jobs, int max_jobs) {
-    for (int i = 0; i < max_jobs; i++) {
-        if (jobs[i].state == FOREGROUND) {
-            return &jobs[i];
+// deletes job from job list
+bool delete_job(job_table_t *table, pid_t pid) {
+    job_t *job = get_job_by_pid(table, pid);
+    if (!job || job->pid != pid) return false; // only the process group identifies a job
+
+    int slot = job - table->jobs;
+    unindex_pid(table, job->pid);
+    for (int p = 0; p < job->nprocs; p++) {
+        if (job->procs[p] != 0) unindex_pid(table, job->procs[p]);
+    }
+    if (table->fg_slot == slot) table->fg_slot = -1;
+    table->used[slot / 64] &= ~(1ULL << (slot % 64));
+    table->count--;
+
+    if (job->nlive <= 0 && table->notify && job->state == BACKGROUND && !job->silent) {
+        queue_completion(table, job);
+    }
+    if (job->nlive <= 0) { // it ran to completion: keep its accounting
+        finished_job_t *finished = &table->finished[table->num_finished++ % JOBS_FINISHED_KEEP];
+        release_string(finished->cmd_line);
+        finished->cmd_line = job->cmd_line; // the reference moves over
+        finished->pid = job->pid;
+        finished->jid = job->jid;
+        finished->usage = job->usage;
+    } else {
+        release_string(job->cmd_line); // drop the job's reference to the command line
+    }
+    close_pidfds(job);
+    free(job->procs); // free the stage pids
+    free(job->pidfds);
+    job->cmd_line = NULL;
+    job->procs = NULL;
+    job->pidfds = NULL;
+    job->nprocs = 0;
+    job->nlive = 0;
+    job->state = UNDEFINED; // set job state to undefined
+    job->pid = -1; // reset pid
+    job->jid = 0; // reset job id
+    return true;
+}
+
+// adds the usage of a reaped process to a job's total
+static void add_rusage(struct rusage *total, const struct rusage *add) {
+    timeradd(&total->ru_utime, &add->ru_utime, &total->ru_utime);
+    timeradd(&total->ru_stime, &add->ru_stime, &total->ru_stime);
+    if (add->ru_maxrss > total->ru_maxrss) total->ru_maxrss = add->ru_maxrss; // the peak of any one process
+    total->ru_minflt += add->ru_minflt;
+    total->ru_majflt += add->ru_majflt;
+    total->ru_inblock += add->ru_inblock;
+    total->ru_oublock += add->ru_oublock;
+    total->ru_nvcsw += add->ru_nvcsw;
+    total->ru_nivcsw += add->ru_nivcsw;
+}
+
+bool job_process_exited(job_table_t *table, job_t *job, pid_t pid, int status, const struct rusage *rusage) {
+    for (int p = 0; p < job->nprocs; p++) {
+        if (job->procs[p] == pid) {
+            if (rusage) add_rusage(&job->usage.rusage, rusage);
+            if (p == job->nprocs - 1) job->usage.status = status; // a pipeline's status is its last stage's
+            job->procs[p] = 0; // reaped pids may be reused, stop matching them
+            if (job->pidfds[p] != -1) close(job->pidfds[p]); // also drops it from any epoll set
+            job->pidfds[p] = -1;
+            job->nlive--;
+            // The group leader's pid stays indexed (it is the job's handle and the kernel does not
+            // reuse it while the group has members); the others are dropped now
+            if (pid != job->pid) unindex_pid(table, pid);
+            break;
         }
     }
+    if (job->nlive <= 0) clock_gettime(CLOCK_MONOTONIC, &job->usage.end);
+    return job->nlive <= 0;
+}
+
+int job_pidfd(const job_t *job, pid_t pid) {
+    for (int p = 0; p < job->nprocs; p++) {
+        if (job->procs[p] == pid) return job->pidfds[p];
+    }
+    return -1;
+}
+
+const finished_job_t *get_finished_job(const job_table_t *table, pid_t pid) {
+    unsigned long kept = table->num_finished < JOBS_FINISHED_KEEP ? table->num_finished : JOBS_FINISHED_KEEP;
+    for (unsigned long i = 1; i <= kept; i++) { // newest first
+        const finished_job_t *finished = &table->finished[(table->num_finished - i) % JOBS_FINISHED_KEEP];
+        if (finished->pid == pid) return finished;
+    }
     return NULL;
 }
 
+double elapsed_seconds(const struct timespec *start, const struct timespec *end) {
+    struct timespec now;
+    if (end->tv_sec == 0 && end->tv_nsec == 0) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        end = &now;
+    }
+    return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
 
 // frees memory allocated for jobs
-void free_jobs(job_t *jobs, int max_jobs) {
-    for (int i = 0; i < max_jobs; i++) {
-        if (jobs[i].state != UNDEFINED) { // check if job is defined
-            free(jobs[i].cmd_line); // free command line memory
+void free_jobs(job_table_t *table) {
+    if (table->jobs) {
+        for (int i = 0; i < table->capacity; i++) {
+            if (table->jobs[i].state != UNDEFINED) { // check if job is defined
+                release_string(table->jobs[i].cmd_line);
+                close_pidfds(&table->jobs[i]);
+                free(table->jobs[i].procs);
+                free(table->jobs[i].pidfds);
+            }
         }
     }
-    free(jobs); // free jobs array
+    for (int i = 0; i < JOBS_FINISHED_KEEP; i++) {
+        release_string(table->finished[i].cmd_line);
+    }
+    clear_completions(table);
+    free(table->completions);
+    free(table->jobs); // free jobs array
+    free(table->used);
+    free(table->pids);
+    free(table);
 }
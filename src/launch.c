@@ -0,0 +1,337 @@
+#define _GNU_SOURCE     // For pipe2
+#include "launch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>      // For O_CLOEXEC
+#include <unistd.h>     // For fork, execve
+#include <spawn.h>      // For posix_spawn
+#include <sched.h>      // For struct sched_param
+#include <sys/socket.h> // For the zygote's socketpair and SCM_RIGHTS
+#include <sys/wait.h>
+#ifdef __linux__
+#include <sys/prctl.h>  // For PR_SET_CHILD_SUBREAPER
+#endif
+
+extern char **environ;
+
+launch_backend_t launch_backend_from_env(void) {
+    const char *backend = getenv(LAUNCH_BACKEND_ENV);
+    if (backend && strcmp(backend, "fork") == 0) {
+        return LAUNCH_FORK;
+    }
+    if (backend && strcmp(backend, "zygote") == 0) {
+        return LAUNCH_ZYGOTE;
+    }
+    return LAUNCH_SPAWN;
+}
+
+// fork + execve, the original launch path
+static pid_t fork_process(const char *path, char **argv, pid_t pgid, const sigset_t *child_mask,
+                          int in_fd, int out_fd, const cpu_mask_t *cpus, const bg_policy_t *bg_policy) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        // Child process: join the job's process group and restore the signal mask
+        setpgid(0, pgid);
+        sigprocmask(SIG_SETMASK, child_mask, NULL);
+        if (cpus && set_cpu_mask(0, cpus) == -1) perror("sched_setaffinity");
+        if (bg_policy && apply_bg_policy(bg_policy, 0) == -1) perror("background priority");
+        if (in_fd != STDIN_FILENO) dup2(in_fd, STDIN_FILENO); // pipe or redirection plumbing
+        if (out_fd != STDOUT_FILENO) dup2(out_fd, STDOUT_FILENO);
+        execve(path, argv, environ);
+        perror("execve");  // If execve fails, report an error
+        _exit(EXIT_FAILURE); // Exit without flushing the parent's stdio buffers
+    }
+    if (pid < 0) {
+        perror("fork");
+        return -1;
+    }
+    setpgid(pid, pgid); // also set it here so the group exists before the parent signals it
+    return pid;
+}
+
+// errors that come from the exec itself rather than from setting up the spawn
+static int is_exec_error(int err) {
+    return err == ENOENT || err == EACCES || err == ENOEXEC || err == ENOTDIR ||
+           err == ELOOP || err == ENAMETOOLONG || err == E2BIG || err == ETXTBSY;
+}
+
+// posix_spawn: the child shares the parent's memory until exec, so no page tables are copied
+static int spawn_process(const char *path, char **argv, pid_t pgid, const sigset_t *child_mask,
+                         int in_fd, int out_fd, const cpu_mask_t *cpus, const bg_policy_t *bg_policy,
+                         pid_t *pid) {
+    posix_spawnattr_t attr;
+    posix_spawn_file_actions_t actions;
+    sigset_t default_signals;
+    int err = posix_spawnattr_init(&attr);
+    if (err) return err;
+    err = posix_spawn_file_actions_init(&actions);
+    if (err) {
+        posix_spawnattr_destroy(&attr);
+        return err;
+    }
+
+    sigemptyset(&default_signals); // the shell's handlers must not leak into the child
+    sigaddset(&default_signals, SIGCHLD);
+    sigaddset(&default_signals, SIGINT);
+    sigaddset(&default_signals, SIGTSTP);
+
+    bool lowered = bg_policy && bg_policy->enabled;
+    err = posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK |
+                                          POSIX_SPAWN_SETSIGDEF | (lowered ? POSIX_SPAWN_SETSCHEDULER : 0));
+    if (!err) err = posix_spawnattr_setpgroup(&attr, pgid);
+    if (!err && lowered) {
+        struct sched_param param = { .sched_priority = 0 };
+        err = posix_spawnattr_setschedpolicy(&attr, bg_policy->sched);
+        if (!err) err = posix_spawnattr_setschedparam(&attr, &param);
+    }
+    if (!err) err = posix_spawnattr_setsigmask(&attr, child_mask);
+    if (!err) err = posix_spawnattr_setsigdefault(&attr, &default_signals);
+    if (!err && in_fd != STDIN_FILENO) err = posix_spawn_file_actions_adddup2(&actions, in_fd, STDIN_FILENO);
+    if (!err && out_fd != STDOUT_FILENO) err = posix_spawn_file_actions_adddup2(&actions, out_fd, STDOUT_FILENO);
+    // The child inherits the shell's CPUs: narrow them for the spawn and widen them again after
+    cpu_mask_t shell_cpus;
+    bool pinned = !err && cpus && get_cpu_mask(0, &shell_cpus);
+    if (pinned && set_cpu_mask(0, cpus) == -1) err = errno;
+    if (!err) err = posix_spawn(pid, path, &actions, &attr, argv, environ);
+    if (pinned) set_cpu_mask(0, &shell_cpus);
+    // Nice level and I/O priority have no spawn attribute; the class above already holds from the exec on
+    if (!err && lowered && apply_bg_policy(bg_policy, *pid) == -1 && errno != ESRCH) perror("background priority");
+
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    return err;
+}
+
+// A launch request sent to the zygote, followed by path, argv, environ and the working directory as
+// NUL-terminated strings; in_fd and out_fd travel as SCM_RIGHTS when they are not stdin/stdout
+typedef struct zygote_request {
+    pid_t pgid;
+    sigset_t child_mask;
+    int argc;
+    int envc;
+    bool has_in;            // in_fd is attached (otherwise the zygote's stdin is used)
+    bool has_out;           // out_fd is attached (otherwise the zygote's stdout is used)
+    bool pinned;            // The process is restricted to cpus
+    cpu_mask_t cpus;
+    bool background;        // The process gets bg_policy
+    bg_policy_t bg_policy;
+} zygote_request_t;
+
+static int zygote_fd = -1;      // The shell's end of the socketpair, or -1 if there is no zygote
+static pid_t zygote_pid = -1;
+
+// appends a string and its NUL to buf, or returns false if it does not fit
+static bool put_string(char *buf, size_t *len, const char *str) {
+    size_t n = strlen(str) + 1;
+    if (*len + n > ZYGOTE_MAX_REQUEST) return false;
+    memcpy(buf + *len, str, n);
+    *len += n;
+    return true;
+}
+
+// runs one launch in the zygote: fork an intermediate child that forks the process and exits, so the
+// process is orphaned and reparented to the shell; returns its pid or -1
+static pid_t zygote_launch(const zygote_request_t *req, char *path, char **argv, char **envp, char *cwd,
+                           int in_fd, int out_fd) {
+    int pid_pipe[2];
+    if (pipe2(pid_pipe, O_CLOEXEC) == -1) return -1;
+    pid_t mid = fork();
+    if (mid == 0) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            setpgid(0, req->pgid);
+            sigprocmask(SIG_SETMASK, &req->child_mask, NULL);
+            if (req->pinned && set_cpu_mask(0, &req->cpus) == -1) perror("sched_setaffinity");
+            if (req->background && apply_bg_policy(&req->bg_policy, 0) == -1) perror("background priority");
+            if (in_fd != STDIN_FILENO) dup2(in_fd, STDIN_FILENO);
+            if (out_fd != STDOUT_FILENO) dup2(out_fd, STDOUT_FILENO);
+            if (chdir(cwd) == -1) {
+                perror(cwd);
+                _exit(EXIT_FAILURE);
+            }
+            execve(path, argv, envp);
+            perror("execve");
+            _exit(EXIT_FAILURE);
+        }
+        if (pid > 0) setpgid(pid, req->pgid); // the group exists before the shell hears of the pid
+        (void)!write(pid_pipe[1], &pid, sizeof(pid));
+        _exit(0);
+    }
+    close(pid_pipe[1]);
+    pid_t pid = -1;
+    if (mid > 0) {
+        if (read(pid_pipe[0], &pid, sizeof(pid)) != sizeof(pid)) pid = -1;
+        waitpid(mid, NULL, 0); // once the intermediate is gone the process belongs to the shell
+    }
+    close(pid_pipe[0]);
+    return pid;
+}
+
+// the zygote's loop: serve launch requests until the shell closes its end
+static void zygote_main(int fd) {
+    setpgid(0, 0); // keep terminal signals meant for the shell's group away
+    char *buf = malloc(ZYGOTE_MAX_REQUEST);
+    if (!buf) _exit(EXIT_FAILURE);
+    union {
+        struct cmsghdr header;
+        char space[CMSG_SPACE(2 * sizeof(int))];
+    } control;
+
+    for (;;) {
+        struct iovec iov = {.iov_base = buf, .iov_len = ZYGOTE_MAX_REQUEST};
+        struct msghdr msg = {.msg_iov = &iov, .msg_iovlen = 1,
+                             .msg_control = control.space, .msg_controllen = sizeof(control.space)};
+        ssize_t n = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) _exit(0);
+
+        int fds[2], nfds = 0;
+        for (struct cmsghdr *c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+            if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_RIGHTS) {
+                nfds = (c->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                if (nfds > 2) nfds = 2;
+                memcpy(fds, CMSG_DATA(c), nfds * sizeof(int));
+            }
+        }
+
+        zygote_request_t req;
+        memcpy(&req, buf, sizeof(req));
+        pid_t pid = -1;
+        char **argv = malloc((req.argc + 1) * sizeof(char *));
+        char **envp = malloc((req.envc + 1) * sizeof(char *));
+        if (argv && envp && nfds == req.has_in + req.has_out) {
+            char *str = buf + sizeof(req);
+            char *path = str;
+            str += strlen(str) + 1;
+            for (int i = 0; i < req.argc; i++, str += strlen(str) + 1) argv[i] = str;
+            argv[req.argc] = NULL;
+            for (int i = 0; i < req.envc; i++, str += strlen(str) + 1) envp[i] = str;
+            envp[req.envc] = NULL;
+            int in_fd = req.has_in ? fds[0] : STDIN_FILENO;
+            int out_fd = req.has_out ? fds[req.has_in] : STDOUT_FILENO;
+            pid = zygote_launch(&req, path, argv, envp, str, in_fd, out_fd);
+        }
+        free(argv);
+        free(envp);
+        for (int i = 0; i < nfds; i++) close(fds[i]);
+        send(fd, &pid, sizeof(pid), MSG_NOSIGNAL);
+    }
+}
+
+bool start_zygote(void) {
+#ifdef __linux__
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) == -1) {
+        perror("socketpair");
+        return false;
+    }
+    if (prctl(PR_SET_CHILD_SUBREAPER, 1) == -1) { // the zygote's orphans come to the shell
+        perror("prctl");
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        zygote_main(fds[1]);
+    }
+    close(fds[1]);
+    if (pid < 0) {
+        perror("fork");
+        close(fds[0]);
+        return false;
+    }
+    zygote_fd = fds[0];
+    zygote_pid = pid;
+    return true;
+#else
+    fprintf(stderr, "error: the zygote launch backend needs Linux\n");
+    return false;
+#endif
+}
+
+void stop_zygote(void) {
+    if (zygote_fd == -1) return;
+    close(zygote_fd); // the zygote sees end-of-file and exits
+    zygote_fd = -1;
+    waitpid(zygote_pid, NULL, 0);
+    zygote_pid = -1;
+}
+
+// sends a launch to the zygote; returns the pid, or -1 if the caller should fork instead
+static pid_t zygote_process(const char *path, char **argv, pid_t pgid, const sigset_t *child_mask,
+                            int in_fd, int out_fd, const cpu_mask_t *cpus, const bg_policy_t *bg_policy) {
+    static char buf[ZYGOTE_MAX_REQUEST];
+    char cwd[4096];
+    if (zygote_fd == -1 || !getcwd(cwd, sizeof(cwd))) return -1;
+
+    zygote_request_t req = {.pgid = pgid, .child_mask = *child_mask,
+                            .has_in = in_fd != STDIN_FILENO, .has_out = out_fd != STDOUT_FILENO,
+                            .pinned = cpus != NULL, .background = bg_policy != NULL};
+    if (cpus) req.cpus = *cpus;
+    if (bg_policy) req.bg_policy = *bg_policy;
+    size_t len = sizeof(req);
+    bool fits = put_string(buf, &len, path);
+    for (; fits && argv[req.argc]; req.argc++) fits = put_string(buf, &len, argv[req.argc]);
+    for (; fits && environ[req.envc]; req.envc++) fits = put_string(buf, &len, environ[req.envc]);
+    if (!fits || !put_string(buf, &len, cwd)) return -1;
+    memcpy(buf, &req, sizeof(req));
+
+    union {
+        struct cmsghdr header;
+        char space[CMSG_SPACE(2 * sizeof(int))];
+    } control;
+    int fds[2], nfds = 0;
+    if (req.has_in) fds[nfds++] = in_fd;
+    if (req.has_out) fds[nfds++] = out_fd;
+    struct iovec iov = {.iov_base = buf, .iov_len = len};
+    struct msghdr msg = {.msg_iov = &iov, .msg_iovlen = 1};
+    if (nfds > 0) {
+        msg.msg_control = control.space;
+        msg.msg_controllen = CMSG_SPACE(nfds * sizeof(int));
+        struct cmsghdr *c = CMSG_FIRSTHDR(&msg);
+        c->cmsg_level = SOL_SOCKET;
+        c->cmsg_type = SCM_RIGHTS;
+        c->cmsg_len = CMSG_LEN(nfds * sizeof(int));
+        memcpy(CMSG_DATA(c), fds, nfds * sizeof(int));
+    }
+
+    ssize_t n;
+    while ((n = sendmsg(zygote_fd, &msg, MSG_NOSIGNAL)) == -1 && errno == EINTR) {}
+    if (n == -1) {
+        if (errno == EMSGSIZE) return -1; // too large for one packet; this launch forks
+        perror("zygote");
+        stop_zygote(); // the zygote is gone; every later launch forks
+        return -1;
+    }
+    pid_t pid;
+    while ((n = recv(zygote_fd, &pid, sizeof(pid), 0)) == -1 && errno == EINTR) {}
+    if (n != sizeof(pid)) {
+        fprintf(stderr, "error: the zygote exited; launching with fork\n");
+        stop_zygote();
+        return -1;
+    }
+    return pid;
+}
+
+pid_t launch_process(launch_backend_t backend, const char *path, char **argv, pid_t pgid,
+                     const sigset_t *child_mask, int in_fd, int out_fd, const cpu_mask_t *cpus,
+                     const bg_policy_t *bg_policy) {
+    if (backend == LAUNCH_SPAWN) {
+        pid_t pid;
+        int err = spawn_process(path, argv, pgid, child_mask, in_fd, out_fd, cpus, bg_policy, &pid);
+        if (!err) return pid;
+        if (is_exec_error(err)) {
+            fprintf(stderr, "execve: %s\n", strerror(err)); // same report as the fork path
+            return -1;
+        }
+        // anything else (e.g. unsupported attributes): fall back to fork
+    } else if (backend == LAUNCH_ZYGOTE) {
+        pid_t pid = zygote_process(path, argv, pgid, child_mask, in_fd, out_fd, cpus, bg_policy);
+        if (pid > 0) return pid;
+    }
+    return fork_process(path, argv, pgid, child_mask, in_fd, out_fd, cpus, bg_policy);
+}
@@ -0,0 +1,141 @@
+#include "lexer.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The spelling of every operator token, indexed by token_type_t
+static char *const OPERATORS[] = { NULL, ";", "&", "|", "<", ">", ">>", "" };
+
+// Characters that end or need special handling inside a word (blanks, operators, quotes, backslash)
+static const bool SPECIAL[256] = {
+    ['\0'] = true, [' '] = true, ['\t'] = true, ['\n'] = true, [';'] = true, ['&'] = true, ['|'] = true,
+    ['<'] = true, ['>'] = true, ['\''] = true, ['"'] = true, ['\\'] = true,
+};
+
+// allocates spill memory from the lexer's arena, or the heap if it has none
+static void *lex_alloc(lexer_t *lex, size_t size) {
+    return lex->arena ? arena_alloc(lex->arena, size) : malloc(size);
+}
+
+// appends a token; false if it could not be allocated
+static bool push_token(lexer_t *lex, token_type_t type, char *text, int start, int end) {
+    if (lex->num_tokens == lex->capacity) {
+        int capacity = lex->capacity * 2;
+        token_t *tokens;
+        if (lex->arena || lex->tokens == lex->inline_tokens) {
+            tokens = lex_alloc(lex, (capacity + 1) * sizeof(token_t));
+            if (tokens) memcpy(tokens, lex->tokens, lex->num_tokens * sizeof(token_t));
+        } else {
+            tokens = realloc(lex->tokens, (capacity + 1) * sizeof(token_t));
+        }
+        if (!tokens) {
+            perror("malloc");
+            return false;
+        }
+        lex->tokens = tokens;
+        lex->capacity = capacity;
+    }
+    lex->tokens[lex->num_tokens++] = (token_t){ type, text, start, end };
+    return true;
+}
+
+// the operator starting at c, or TOK_WORD if there is none
+static token_type_t operator_at(const char *c, int *len) {
+    *len = 1;
+    switch (*c) {
+        case ';': return TOK_SEMI;
+        case '&': return TOK_AMP;
+        case '|': return TOK_PIPE;
+        case '<': return TOK_IN;
+        case '>':
+            if (c[1] == '>') {
+                *len = 2;
+                return TOK_APPEND;
+            }
+            return TOK_OUT;
+        default: return TOK_WORD;
+    }
+}
+
+int lex_line(lexer_t *lex, const char *line, arena_t *arena) {
+    size_t len = strlen(line);
+    lex->arena = arena;
+    lex->tokens = lex->inline_tokens;
+    lex->capacity = LEX_INLINE_TOKENS - 1; // keep a slot for TOK_END
+    lex->num_tokens = 0;
+    lex->text = lex->inline_text;
+
+    // A word's NUL takes the place of the blank or operator after it, so the words never need more room
+    // than the line itself
+    if (len + 1 > LEX_INLINE_TEXT) {
+        lex->text = lex_alloc(lex, len + 1);
+        if (!lex->text) {
+            perror("malloc");
+            return -1;
+        }
+    }
+
+    char *out = lex->text;
+    const char *c = line;
+    while (*c) {
+        if (*c == ' ' || *c == '\t' || *c == '\n') { // skip blanks
+            c++;
+            continue;
+        }
+
+        int op_len;
+        token_type_t op = operator_at(c, &op_len);
+        if (op != TOK_WORD) {
+            if (!push_token(lex, op, OPERATORS[op], c - line, c - line + op_len)) return -1;
+            c += op_len;
+            continue;
+        }
+
+        // A word runs until an unquoted blank or operator
+        const char *start = c;
+        char *word = out;
+        for (;;) {
+            while (!SPECIAL[(unsigned char)*c]) { // plain characters
+                *out++ = *c++;
+            }
+            if (*c == '\'') {
+                const char *close = strchr(c + 1, '\'');
+                if (!close) goto unterminated;
+                memcpy(out, c + 1, close - c - 1);
+                out += close - c - 1;
+                c = close + 1;
+            } else if (*c == '"') {
+                for (c++; *c != '"'; c++) {
+                    if (*c == '\0') goto unterminated;
+                    if (*c == '\\' && (c[1] == '"' || c[1] == '\\')) c++;
+                    *out++ = *c;
+                }
+                c++;
+            } else if (*c == '\\') {
+                if (c[1] != '\0') c++; // a trailing backslash is literal
+                *out++ = *c++;
+            } else {
+                break; // a blank, an operator or the end of the line
+            }
+        }
+        *out++ = '\0';
+        if (!push_token(lex, TOK_WORD, word, start - line, c - line)) return -1;
+    }
+
+    lex->tokens[lex->num_tokens] = (token_t){ TOK_END, OPERATORS[TOK_END], len, len };
+    return lex->num_tokens;
+
+unterminated:
+    fprintf(stderr, "error: syntax error: unterminated quote\n");
+    return -1;
+}
+
+void lex_free(lexer_t *lex) {
+    if (!lex->arena) {
+        if (lex->tokens != lex->inline_tokens) free(lex->tokens);
+        if (lex->text != lex->inline_text) free(lex->text);
+    }
+    lex->tokens = lex->inline_tokens;
+    lex->text = lex->inline_text;
+}
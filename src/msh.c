@@ -7,7 +7,17 @@
 #include "job.h"
 #include <sys/wait.h>
 #include <unistd.h>  // For usleep
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/mman.h> // For mmap
+#include <sys/stat.h> // For fstat
 #include "signal_handlers.h"
+#include "pipeline.h"
+#include "trace.h"
+
+#define BATCH_BLOCK_SIZE 65536 // bytes read from a non-seekable script at a time
+#define BATCH_OUTPUT_SIZE 65536 // stdout buffer in batch mode
 
 // M2 
 // makes sure before you exit the shell to check for background jobs 
@@ -22,16 +32,21 @@ void print_usage_and_exit() {
 }
 
 // parse command-line arguments
-void parse_args(int argc, char *argv[], int *max_jobs, int *max_line, int *max_history) {
+void parse_args(int argc, char *argv[], int *max_jobs, int *max_line, int *max_history,
+                char **command, bool *interactive, bool *quiet, affinity_policy_t *affinity) {
     *max_jobs = 0;
     *max_line = 0;
     *max_history = 0;
+    *command = NULL;
+    *interactive = false;
+    *quiet = false;
+    *affinity = AFFINITY_NONE;
 
     int opt;
     opterr = 0; // disable getopt's automatic error messages
 
     // parse arguments using getopt()
-    while ((opt = getopt(argc, argv, ":s:j:l:")) != -1) {
+    while ((opt = getopt(argc, argv, ":s:j:l:c:ibA:")) != -1) {
         switch (opt) {
             case 's':
                 // check if argument is valid for option 's'
@@ -54,6 +69,24 @@ void parse_args(int argc, char *argv[], int *max_jobs, int *max_line, int *max_h
                 }
                 break;
 
+            case 'c': // run COMMAND instead of reading stdin
+                *command = optarg;
+                break;
+
+            case 'i': // prompt and read line by line even if stdin is not a terminal
+                *interactive = true;
+                break;
+
+            case 'b': // scripts and pipes run without printing prompts
+                *quiet = true;
+                break;
+
+            case 'A': // spread background jobs over the CPUs: rr or numa
+                if (!parse_affinity_policy(optarg, affinity)) {
+                    print_usage_and_exit(); // exit immediately if invalid
+                }
+                break;
+
             case ':': // missing argument for option
                 print_usage_and_exit(); // exit immediately if invalid
                 break;
@@ -73,63 +106,160 @@ void parse_args(int argc, char *argv[], int *max_jobs, int *max_line, int *max_h
     }
 }
 
+// runs one input line; returns false once the shell should exit
+static bool run_line(msh_t *shell, char *line) {
+    if (strlen(line) == 0) return true;
+    if (strcmp(line, "exit") == 0) return false;
+
+    TRACE(TRACE_LINE_READ, 0);
+    evaluate(shell, line);
+    arena_reset(shell->arena); // everything the line needed goes at once
+    handle_signal_events(); // apply child state changes that arrived while the command ran
+
+    admit_queued_jobs(shell); // start queued background jobs in the slots that freed up
+    report_completions(shell); // background jobs reaped since the last prompt
+    TRACE(TRACE_PROMPT, 0);
+    return true;
+}
+
+// with set -b, reports jobs that finish while the shell waits at the prompt, until input arrives
+static void wait_for_input(msh_t *shell) {
+    // A terminal delivers one line per read, so stdio holds nothing once the last line was taken
+    if (!shell->notify_now || !isatty(STDIN_FILENO)) return;
+    struct pollfd fds[2] = {{.fd = STDIN_FILENO, .events = POLLIN},
+                            {.fd = signal_event_fd(), .events = POLLIN}};
+    for (;;) {
+        if (poll(fds, 2, -1) == -1) {
+            if (errno == EINTR) continue;
+            perror("poll");
+            return;
+        }
+        if (fds[0].revents) return;
+        unsigned long finished = shell->jobs->num_finished;
+        handle_signal_events(); // reaping reports the jobs at once
+        admit_queued_jobs(shell);
+        if (shell->jobs->num_finished != finished) { // a notice was printed over the prompt
+            printf("msh> ");
+            fflush(stdout);
+        }
+    }
+}
+
 // repl loop 
 void repl_loop(msh_t *shell) {
     char *line = NULL;
     size_t len = 0;
+    shell->jobs->notify = true; // someone is watching: tell them when background jobs finish
 
     while (1) {
         printf("msh> ");
+        fflush(stdout);
+        wait_for_input(shell);
         ssize_t nread = getline(&line, &len, stdin);
 
         if (nread == -1) break;
 
         line[strcspn(line, "\n")] = '\0'; // Remove newline
 
-        if (strlen(line) == 0) continue;
-        if (strcmp(line, "exit") == 0) break;
+        if (!run_line(shell, line)) break;
+    }
 
-        evaluate(shell, line);
+    free(line);
+}
 
-        // Check for completed background jobs after each command
-        int status;
-        for (int i = 0; i < shell->max_jobs; i++) {
-            if (shell->jobs[i].state == BACKGROUND) {
-                pid_t term_pid = waitpid(shell->jobs[i].pid, &status, WNOHANG);
-                if (term_pid > 0) {
-                    printf("Background job (PID: %d) completed.\n", term_pid);
-                    delete_job(shell->jobs, shell->max_jobs, term_pid);
-                }
+// batch input: a script split into lines without a read per line
+typedef struct batch {
+    char *line;   // copy of the current line (evaluate modifies it)
+    size_t cap;   // bytes allocated for line
+    bool prompt;  // print `msh> ` before each line and at end-of-file, as the interactive loop does
+} batch_t;
+
+// runs every complete line of input from input->pos on, and the unterminated last one at end-of-file;
+// returns false after exit. A builtin may read lines of input meanwhile (see read_input_line).
+static bool run_lines(msh_t *shell, batch_t *batch, script_input_t *input) {
+    while (input->pos < input->len) {
+        const char *text = input->text + input->pos; // anew each time: a builtin may have moved it
+        const char *end = memchr(text, '\n', input->len - input->pos);
+        if (!end && !input->eof) break; // wait for the rest of the line
+        size_t n = (end ? end : input->text + input->len) - text;
+
+        if (n + 1 > batch->cap) {
+            char *grown = realloc(batch->line, n + 1);
+            if (!grown) {
+                perror("realloc");
+                return false;
             }
+            batch->line = grown;
+            batch->cap = n + 1;
         }
-    }
+        memcpy(batch->line, text, n);
+        batch->line[n] = '\0';
+        input->pos += n + (end != NULL);
 
-    free(line);
+        if (batch->prompt) fputs("msh> ", stdout); // buffered: costs no write of its own
+        if (!run_line(shell, batch->line)) return false;
+    }
+    return true;
 }
 
+// runs a script mapped whole if it is a regular file, otherwise read in large blocks; prompt keeps the
+// output of the interactive loop (-b turns it off)
+void batch_loop(msh_t *shell, int fd, bool prompt) {
+    batch_t batch = { NULL, 0, prompt };
+    setvbuf(stdout, NULL, _IOFBF, BATCH_OUTPUT_SIZE); // flushed before every launch (see run_job)
+
+    struct stat st;
+    off_t start = lseek(fd, 0, SEEK_CUR);
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && start != -1 && st.st_size > start) {
+        char *script = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (script != MAP_FAILED) {
+            // Commands see end-of-file on stdin, as they did when stdio had already buffered the script
+            lseek(fd, st.st_size, SEEK_SET);
+            madvise(script, st.st_size, MADV_SEQUENTIAL);
+            script_input_t input = { script, st.st_size, start, 0, fd, true };
+            shell->input = &input;
+            bool ok = run_lines(shell, &batch, &input);
+            if (ok && prompt) fputs("msh> ", stdout); // the prompt that meets end-of-file
+            shell->input = NULL;
+            munmap(script, st.st_size);
+            free(batch.line);
+            return;
+        }
+    }
 
-// handle sigchld signal
-void handle_sigchld(int sig) {
-    int status;
-    pid_t pid;
-    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
-        delete_job(shell->jobs, shell->max_jobs, pid); // delete completed job from job list
+    script_input_t input = { malloc(BATCH_BLOCK_SIZE), 0, 0, BATCH_BLOCK_SIZE, fd, false };
+    if (!input.text) {
+        perror("malloc");
+        return;
+    }
+    shell->input = &input;
+    bool ok;
+    while ((ok = run_lines(shell, &batch, &input)) && !input.eof) {
+        fill_script_input(&input);
     }
+    if (ok && prompt) fputs("msh> ", stdout); // the prompt that meets end-of-file
+    shell->input = NULL;
+    free(input.text);
+    free(batch.line);
 }
 
-// setup signal handlers
-void setup_signal_handlers() {
-    struct sigaction sa;
-    sa.sa_handler = handle_sigchld; // set handler for sigchld
-    sa.sa_flags = SA_RESTART | SA_NOCLDSTOP; // restart system calls and ignore stopped child processes
-    sigaction(SIGCHLD, &sa, NULL); // apply sigchld handler
+// runs the -c argument; every line of it is a command line
+static void command_loop(msh_t *shell, const char *command) {
+    batch_t batch = { NULL, 0, false };
+    script_input_t input = { (char *)command, strlen(command), 0, 0, -1, true }; // not the shell's stdin
+    setvbuf(stdout, NULL, _IOFBF, BATCH_OUTPUT_SIZE);
+    run_lines(shell, &batch, &input);
+    free(batch.line);
 }
 
 int main(int argc, char *argv[]) {
     int max_jobs = 0, max_line = 0, max_history = 0;  // Declare variables here
+    char *command = NULL;
+    bool interactive = false, quiet = false;
+    affinity_policy_t affinity;
 
     // Parse arguments
-    parse_args(argc, argv, &max_jobs, &max_line, &max_history);
+    parse_args(argc, argv, &max_jobs, &max_line, &max_history, &command, &interactive, &quiet, &affinity);
 
     // Initialize shell state
     shell = alloc_shell(max_jobs, max_line, max_history);
@@ -137,12 +267,16 @@ int main(int argc, char *argv[]) {
         fprintf(stderr, "error: unable to allocate memory for shell\n");
         exit(EXIT_FAILURE);
     }
+    shell->affinity = affinity;
 
-    // Initialize signal handlers
-    initialize_signal_handlers();
-
-    // Run the REPL loop
-    repl_loop(shell);
+    // Scripts and pipes are read in batch mode: in large blocks, with the prompt unless -b; -c never prompts
+    if (command) {
+        command_loop(shell, command);
+    } else if (interactive || isatty(STDIN_FILENO)) {
+        repl_loop(shell);
+    } else {
+        batch_loop(shell, STDIN_FILENO, !quiet);
+    }
 
     // Cleanup and exit
     exit_shell(shell);
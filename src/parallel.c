@@ -0,0 +1,290 @@
+#include "parallel.h"
+#include "builtins.h"
+#include "shell.h"
+#include "launch.h"
+#include "signal_handlers.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>     // For INT_MAX
+#include <fcntl.h>      // For open, O_CLOEXEC
+#include <unistd.h>
+#include <signal.h>     // For kill
+#include <sys/wait.h>   // For waitpid
+
+#define PLACEHOLDER_LEN (sizeof(PARALLEL_PLACEHOLDER) - 1)
+
+// One run of the command in flight
+typedef struct parallel_run {
+    pid_t pid;          // The run's process (and process group), or 0 for a free slot
+    long seq;           // The number of the run's item
+} parallel_run_t;
+
+// The output of a run held back by -k
+typedef struct parallel_output {
+    FILE *file;         // The run's captured standard output, or NULL if it could not be started
+    bool done;          // true once the run has finished
+} parallel_output_t;
+
+typedef struct parallel {
+    char **command;             // The command template
+    int command_len;            // The number of words in the template
+    bool has_placeholder;       // true if a word of the template contains {}
+    char **items;               // The items after :::, or NULL to read lines from stdin
+    int num_items;              // The number of items after :::
+    char *line;                 // The last line read from stdin (see read_input_line)
+    size_t line_cap;            // The size of line
+    int max_running;            // -j
+    bool keep_order;            // -k
+    parallel_run_t *runs;       // max_running slots for the runs in flight
+    int running;                // The number of runs in flight
+    long started;               // The number of items started so far
+    parallel_output_t *outputs; // With -k, the outputs of runs started - window .. started, by seq % window
+    long window;                // The number of outputs -k may hold back
+    long next_print;            // With -k, the item whose output is printed next
+    int null_fd;                // /dev/null, the stdin of every run
+} parallel_t;
+
+// returns the next item, or NULL when there are none left
+static const char *next_item(parallel_t *p) {
+    if (p->items) {
+        return p->started < p->num_items ? p->items[p->started] : NULL;
+    }
+    return read_input_line(shell, &p->line, &p->line_cap) == -1 ? NULL : p->line;
+}
+
+// returns a malloc'd copy of word with every {} replaced by item
+static char *expand_word(const char *word, const char *item) {
+    size_t item_len = strlen(item), len = 0;
+    for (const char *s = word; *s; s++) {
+        len += strncmp(s, PARALLEL_PLACEHOLDER, PLACEHOLDER_LEN) == 0 ? (s += PLACEHOLDER_LEN - 1, item_len) : 1;
+    }
+    char *expanded = malloc(len + 1);
+    if (!expanded) return NULL;
+    char *out = expanded;
+    for (const char *s = word; *s; s++) {
+        if (strncmp(s, PARALLEL_PLACEHOLDER, PLACEHOLDER_LEN) == 0) {
+            memcpy(out, item, item_len);
+            out += item_len;
+            s += PLACEHOLDER_LEN - 1;
+        } else {
+            *out++ = *s;
+        }
+    }
+    *out = '\0';
+    return expanded;
+}
+
+// prints the held back outputs that are next in order
+static void print_outputs(parallel_t *p) {
+    while (p->next_print < p->started && p->outputs[p->next_print % p->window].done) {
+        parallel_output_t *output = &p->outputs[p->next_print % p->window];
+        if (output->file) {
+            char buf[8192];
+            size_t n;
+            rewind(output->file);
+            while ((n = fread(buf, 1, sizeof(buf), output->file)) > 0) {
+                fwrite(buf, 1, n, stdout);
+            }
+            fclose(output->file);
+        }
+        output->file = NULL;
+        output->done = false;
+        p->next_print++;
+    }
+}
+
+// starts the run of one item; a run that cannot be started counts as finished
+static void start_run(parallel_t *p, const char *item) {
+    long seq = p->started++;
+    parallel_output_t *output = p->keep_order ? &p->outputs[seq % p->window] : NULL;
+    if (output) {
+        output->file = NULL;
+        output->done = true; // until the run is under way
+    }
+
+    // The run's strings live on the heap, not in the shell's arena: parallel may start any
+    // number of runs before the line finishes and the arena is reset. The job table interns
+    // cmd_line and the child has its own argv, so both are freed once the run is launched.
+    int argc = p->command_len + !p->has_placeholder;
+    char **argv = calloc(argc + 1, sizeof(char *));
+    char *cmd_line = NULL;
+    if (!argv) goto failed;
+    size_t cmd_len = 0;
+    for (int i = 0; i < p->command_len; i++) {
+        argv[i] = p->has_placeholder ? expand_word(p->command[i], item) : p->command[i];
+        if (!argv[i]) goto failed;
+    }
+    if (!p->has_placeholder) argv[argc - 1] = (char *)item;
+    argv[argc] = NULL;
+
+    // The job table shows the command as it runs
+    for (int i = 0; i < argc; i++) cmd_len += strlen(argv[i]) + 1;
+    cmd_line = malloc(cmd_len);
+    if (!cmd_line) goto failed;
+    cmd_line[0] = '\0';
+    for (int i = 0; i < argc; i++) {
+        if (i > 0) strcat(cmd_line, " ");
+        strcat(cmd_line, argv[i]);
+    }
+
+    int out_fd = STDOUT_FILENO;
+    if (output) {
+        output->file = tmpfile();
+        if (!output->file) {
+            perror("parallel: tmpfile");
+            goto failed;
+        }
+        out_fd = fileno(output->file);
+        fcntl(out_fd, F_SETFD, FD_CLOEXEC); // only this run gets it
+    }
+
+    const char *exec_path = resolve_path(shell->path_cache, argv[0]);
+    if (!exec_path) exec_path = argv[0]; // not in PATH: let execve report the error
+    TRACE(TRACE_PATH_RESOLVED, 0);
+    // Runs are background jobs: the -A policy places them and MSH_BG_SCHED lowers them like any other
+    cpu_mask_t placed;
+    bool pinned = place_job(shell->affinity, shell->jobs, 1, &placed);
+    fflush(stdout);
+    pid_t pid = launch_process(shell->launch_backend, exec_path, argv, 0, child_signal_mask(),
+                               p->null_fd, out_fd, pinned ? &placed : NULL, &shell->bg_policy);
+    if (pid <= 0) goto failed;
+    TRACE(TRACE_LAUNCHED, pid);
+    if (!add_job(shell->jobs, pid, &pid, 1, BACKGROUND, cmd_line)) {
+        int status; // nobody else will reap it
+        waitpid(pid, &status, 0);
+        goto done;
+    }
+    job_t *job = get_job_by_pid(shell->jobs, pid);
+    job->silent = true; // parallel reports its runs itself
+    if (pinned) { // later runs are placed around it
+        job->pinned = true;
+        job->cpus = placed;
+    }
+
+    for (int i = 0; i < p->max_running; i++) {
+        if (p->runs[i].pid == 0) {
+            p->runs[i].pid = pid;
+            p->runs[i].seq = seq;
+            break;
+        }
+    }
+    p->running++;
+    if (output) output->done = false;
+    goto done;
+
+failed:
+    builtin_status = 1;
+done:
+    if (argv && p->has_placeholder) {
+        for (int i = 0; i < p->command_len; i++) free(argv[i]);
+    }
+    free(argv);
+    free(cmd_line);
+}
+
+// frees the slots of the runs that the reaper has removed from the job table
+static void collect_runs(parallel_t *p) {
+    for (int i = 0; i < p->max_running; i++) {
+        parallel_run_t *run = &p->runs[i];
+        if (run->pid != 0 && !get_job_by_pid(shell->jobs, run->pid)) {
+            if (p->keep_order) p->outputs[run->seq % p->window].done = true;
+            run->pid = 0;
+            p->running--;
+        }
+    }
+    if (p->keep_order) print_outputs(p);
+}
+
+// Command: parallel [-j N] [-k] COMMAND [ARG...] [::: ITEM...]
+char *builtin_parallel(int argc, char **argv) {
+    parallel_t p = {.max_running = (int)sysconf(_SC_NPROCESSORS_ONLN), .null_fd = -1};
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; i++) {
+        if (strcmp(argv[i], "-k") == 0) {
+            p.keep_order = true;
+        } else if (strncmp(argv[i], "-j", 2) == 0) {
+            // -j N or -jN
+            const char *count = argv[i][2] ? &argv[i][2] : (i + 1 < argc ? argv[++i] : "");
+            char *end;
+            long n = strtol(count, &end, 10);
+            if (end == count || *end != '\0' || n < 1 || n > INT_MAX) {
+                fprintf(stderr, "parallel: -j needs a positive number\n");
+                builtin_status = 2;
+                return NULL;
+            }
+            p.max_running = (int)n;
+        } else {
+            break;
+        }
+    }
+    p.command = &argv[i];
+    for (; i < argc && strcmp(argv[i], PARALLEL_ARGS_SEP) != 0; i++) {
+        if (strstr(argv[i], PARALLEL_PLACEHOLDER)) p.has_placeholder = true;
+        p.command_len++;
+    }
+    if (i < argc) {
+        p.items = &argv[i + 1];
+        p.num_items = argc - i - 1;
+    }
+    if (p.command_len == 0) {
+        fprintf(stderr, "usage: parallel [-j N] [-k] COMMAND [ARG...] [::: ITEM...]\n");
+        builtin_status = 2;
+        return NULL;
+    }
+    if (p.max_running < 1) p.max_running = 1;
+
+    builtin_status = 0;
+    p.window = 2 * (long)p.max_running;
+    p.runs = calloc(p.max_running, sizeof(parallel_run_t));
+    p.outputs = p.keep_order ? calloc(p.window, sizeof(parallel_output_t)) : NULL;
+    p.null_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    if (!p.runs || (p.keep_order && !p.outputs) || p.null_fd == -1) {
+        perror("parallel");
+        builtin_status = 1;
+        goto done;
+    }
+
+    take_interrupt(); // a Ctrl+C from before parallel started is not meant for it
+    bool stop = false, exhausted = false;
+    while ((!stop && !exhausted) || p.running > 0) {
+        // Fill the free slots; -k also waits while too many outputs are held back
+        while (!stop && !exhausted && p.running < p.max_running &&
+               (!p.keep_order || p.started < p.next_print + p.window)) {
+            if (job_table_full(shell->jobs)) {
+                if (p.running == 0) {
+                    fprintf(stderr, "error: job table full (%d jobs); set %s=1 to grow it\n",
+                            shell->jobs->max_jobs, JOBS_GROW_ENV);
+                    builtin_status = 1;
+                    stop = true;
+                }
+                break;
+            }
+            const char *item = next_item(&p);
+            if (!item) {
+                exhausted = true;
+                break;
+            }
+            start_run(&p, item);
+        }
+
+        if (p.running > 0) wait_signal_events(-1);
+        if (take_interrupt()) { // Ctrl+C: start nothing more and pass it on to the runs
+            stop = true;
+            for (int r = 0; r < p.max_running; r++) {
+                if (p.runs[r].pid != 0) kill(-p.runs[r].pid, SIGINT);
+            }
+        }
+        collect_runs(&p);
+    }
+
+done:
+    if (!p.items) clearerr(stdin); // the shell may read more commands from it
+    if (p.null_fd != -1) close(p.null_fd);
+    free(p.runs);
+    free(p.outputs);
+    free(p.line);
+    return NULL;
+}
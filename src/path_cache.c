@@ -0,0 +1,174 @@
+#include "path_cache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>     // For access
+#include <limits.h>     // For PATH_MAX
+
+// djb2 string hash
+static unsigned long hash_name(const char *str) {
+    unsigned long hash = 5381;
+    int c;
+    while ((c = (unsigned char)*str++)) {
+        hash = ((hash << 5) + hash) + c;
+    }
+    return hash;
+}
+
+path_cache_t *alloc_path_cache(void) {
+    path_cache_t *cache = malloc(sizeof(path_cache_t));
+    if (!cache) {
+        perror("malloc");
+        return NULL;
+    }
+
+    cache->buckets = calloc(PATH_CACHE_BUCKETS, sizeof(path_entry_t *));
+    if (!cache->buckets) {
+        perror("calloc");
+        free(cache);
+        return NULL;
+    }
+    cache->num_buckets = PATH_CACHE_BUCKETS;
+    cache->count = 0;
+    cache->path_env = NULL;
+    return cache;
+}
+
+static void free_entry(path_entry_t *entry) {
+    free(entry->name);
+    free(entry->path);
+    free(entry);
+}
+
+void clear_path_cache(path_cache_t *cache) {
+    for (int i = 0; i < cache->num_buckets; i++) {
+        path_entry_t *entry = cache->buckets[i];
+        while (entry) {
+            path_entry_t *next = entry->next;
+            free_entry(entry);
+            entry = next;
+        }
+        cache->buckets[i] = NULL;
+    }
+    cache->count = 0;
+}
+
+// doubles the bucket array once the average chain length exceeds 2
+static void grow_path_cache(path_cache_t *cache) {
+    int num_buckets = cache->num_buckets * 2;
+    path_entry_t **buckets = calloc(num_buckets, sizeof(path_entry_t *));
+    if (!buckets) return; // keep the old table, chains just get longer
+
+    for (int i = 0; i < cache->num_buckets; i++) {
+        path_entry_t *entry = cache->buckets[i];
+        while (entry) {
+            path_entry_t *next = entry->next;
+            unsigned long b = hash_name(entry->name) % num_buckets;
+            entry->next = buckets[b];
+            buckets[b] = entry;
+            entry = next;
+        }
+    }
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->num_buckets = num_buckets;
+}
+
+// searches every PATH directory for an executable named cmd
+static char *search_path(const char *path_env, const char *cmd) {
+    char full_path[PATH_MAX];
+    size_t cmd_len = strlen(cmd);
+    const char *dir = path_env;
+
+    while (dir) {
+        const char *end = strchr(dir, ':');
+        size_t dir_len = end ? (size_t)(end - dir) : strlen(dir);
+
+        if (dir_len == 0) { // an empty PATH element means the current directory
+            if (cmd_len + 1 <= sizeof(full_path)) {
+                memcpy(full_path, cmd, cmd_len + 1);
+                if (access(full_path, X_OK) == 0) return strdup(full_path);
+            }
+        } else if (dir_len + cmd_len + 2 <= sizeof(full_path)) {
+            memcpy(full_path, dir, dir_len);
+            full_path[dir_len] = '/';
+            memcpy(full_path + dir_len + 1, cmd, cmd_len + 1);
+            if (access(full_path, X_OK) == 0) return strdup(full_path);
+        }
+        dir = end ? end + 1 : NULL;
+    }
+    return NULL;
+}
+
+const char *resolve_path(path_cache_t *cache, const char *cmd) {
+    if (strchr(cmd, '/')) return cmd; // explicit paths bypass PATH entirely
+
+    const char *path_env = getenv("PATH");
+    if (!path_env) return NULL;
+
+    // a different PATH invalidates every entry
+    if (!cache->path_env || strcmp(cache->path_env, path_env) != 0) {
+        clear_path_cache(cache);
+        free(cache->path_env);
+        cache->path_env = strdup(path_env);
+    }
+
+    unsigned long b = hash_name(cmd) % cache->num_buckets;
+    path_entry_t **link = &cache->buckets[b];
+    while (*link) {
+        path_entry_t *entry = *link;
+        if (strcmp(entry->name, cmd) == 0) {
+            if (entry->path && access(entry->path, X_OK) == 0) { // hit, still executable
+                entry->hits++;
+                return entry->path;
+            }
+            if (!entry->path && time(NULL) - entry->miss_time < PATH_CACHE_MISS_TTL) { // recent miss
+                entry->hits++;
+                return NULL;
+            }
+            *link = entry->next; // stale: drop it and search again
+            free_entry(entry);
+            cache->count--;
+            break;
+        }
+        link = &entry->next;
+    }
+
+    path_entry_t *entry = malloc(sizeof(path_entry_t));
+    if (!entry) return NULL;
+    entry->name = strdup(cmd);
+    entry->path = search_path(path_env, cmd);
+    entry->miss_time = entry->path ? 0 : time(NULL);
+    entry->hits = 1;
+    entry->next = cache->buckets[b];
+    cache->buckets[b] = entry;
+    cache->count++;
+
+    const char *path = entry->path;
+    if (cache->count > cache->num_buckets * 2) {
+        grow_path_cache(cache);
+    }
+    return path;
+}
+
+void print_path_cache(path_cache_t *cache) {
+    if (cache->count == 0) {
+        printf("hash: hash table empty\n");
+        return;
+    }
+    printf("hits\tcommand\n");
+    for (int i = 0; i < cache->num_buckets; i++) {
+        for (path_entry_t *entry = cache->buckets[i]; entry; entry = entry->next) {
+            if (entry->path) {
+                printf("%4u\t%s\n", entry->hits, entry->path);
+            }
+        }
+    }
+}
+
+void free_path_cache(path_cache_t *cache) {
+    clear_path_cache(cache);
+    free(cache->buckets);
+    free(cache->path_env);
+    free(cache);
+}
@@ -0,0 +1,425 @@
+#define _GNU_SOURCE     // For pipe2
+#include "pipeline.h"
+#include "launch.h"
+#include "signal_handlers.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>      // For open, O_CLOEXEC
+#include <unistd.h>
+#include <sys/wait.h>   // For waitpid
+#include <sys/resource.h> // For getrusage
+#include <sys/time.h>   // For timersub
+#include <time.h>       // For clock_gettime
+
+int parse_pipeline(const token_t *tokens, int num_tokens, pipeline_t *pipeline, arena_t *arena) {
+    int num_stages = 1;
+    for (int i = 0; i < num_tokens; i++) {
+        if (tokens[i].type == TOK_PIPE) num_stages++;
+    }
+
+    pipeline->stages = pipeline->inline_stages;
+    pipeline->args = pipeline->inline_args;
+    pipeline->num_stages = 0;
+    if (num_stages > PIPELINE_INLINE_STAGES) {
+        pipeline->stages = arena_alloc(arena, num_stages * sizeof(stage_t));
+    }
+    if (num_tokens + num_stages > PIPELINE_INLINE_ARGS) { // every word plus a NULL per stage
+        pipeline->args = arena_alloc(arena, (num_tokens + num_stages) * sizeof(char *));
+    }
+    if (!pipeline->stages || !pipeline->args) return -1;
+
+    char **args = pipeline->args;
+    int t = 0;
+    for (int i = 0; i < num_stages; i++) {
+        stage_t *stage = &pipeline->stages[i];
+        *stage = (stage_t){ args, 0, false, NULL, NULL, false };
+        pipeline->num_stages++;
+
+        for (; t < num_tokens && tokens[t].type != TOK_PIPE; t++) {
+            const token_t *tok = &tokens[t];
+            if (tok->type == TOK_WORD) { // ordinary argument
+                args[stage->argc++] = tok->text;
+                continue;
+            }
+            // `<`, `>` or `>>`: the file name is the next word
+            if (t + 1 >= num_tokens || tokens[t + 1].type != TOK_WORD) {
+                fprintf(stderr, "error: syntax error: missing file name after redirection\n");
+                return -1;
+            }
+            if (tok->type == TOK_IN) {
+                stage->in_file = tokens[++t].text;
+            } else {
+                stage->out_file = tokens[++t].text;
+                stage->append = tok->type == TOK_APPEND;
+            }
+        }
+        t++; // skip the `|`
+        args[stage->argc] = NULL;
+        args += stage->argc + 1;
+
+        if (stage->argc == 0) {
+            if (num_stages == 1 && !stage->in_file && !stage->out_file) { // blank job
+                return 0;
+            }
+            fprintf(stderr, "error: syntax error: empty command in pipeline\n");
+            return -1;
+        }
+        stage->builtin = find_builtin(stage->argv[0]);
+        if (stage->argc > 1 && strcmp(stage->argv[0], "command") == 0) { // command NAME: the real program
+            stage->argv++;
+            stage->argc--;
+            stage->builtin = find_builtin(stage->argv[0]);
+            if (stage->builtin && (stage->builtin->flags & BUILTIN_UTILITY)) stage->builtin = NULL;
+        }
+        if (stage->builtin && num_stages > 1 && !(stage->builtin->flags & BUILTIN_IN_PIPELINE)) {
+            fprintf(stderr, "error: %s cannot be used in a pipeline\n", stage->argv[0]);
+            return -1;
+        }
+    }
+    return num_stages;
+}
+
+// opens a redirection target close-on-exec so only the child's duplicated copy survives the exec
+static int open_redirection(const char *file, int flags) {
+    int fd = open(file, flags | O_CLOEXEC, 0666);
+    if (fd == -1) {
+        fprintf(stderr, "error: %s: %s\n", file, strerror(errno));
+    }
+    return fd;
+}
+
+static int output_flags(const stage_t *stage) {
+    return O_WRONLY | O_CREAT | (stage->append ? O_APPEND : O_TRUNC);
+}
+
+// runs a builtin in a forked copy of the shell so it can be a pipeline stage
+static pid_t launch_builtin(stage_t *stage, pid_t pgid, const sigset_t *child_mask, int in_fd, int out_fd,
+                            const cpu_mask_t *cpus, const bg_policy_t *bg_policy) {
+    fflush(stdout); // the child must not repeat the shell's buffered output
+    pid_t pid = fork();
+    if (pid == 0) {
+        setpgid(0, pgid);
+        signal(SIGCHLD, SIG_DFL); // this copy is a job, not the shell
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTSTP, SIG_DFL);
+        sigprocmask(SIG_SETMASK, child_mask, NULL);
+        if (cpus && set_cpu_mask(0, cpus) == -1) perror("sched_setaffinity");
+        if (bg_policy && apply_bg_policy(bg_policy, 0) == -1) perror("background priority");
+        if (in_fd != STDIN_FILENO) dup2(in_fd, STDIN_FILENO);
+        if (out_fd != STDOUT_FILENO) dup2(out_fd, STDOUT_FILENO);
+
+        builtin_status = 0;
+        stage->builtin->handler(stage->argc, stage->argv);
+        fflush(stdout);
+        _exit(builtin_status);
+    }
+    if (pid < 0) {
+        perror("fork");
+        return -1;
+    }
+    setpgid(pid, pgid);
+    return pid;
+}
+
+// runs a builtin that makes up the whole job inside the shell, applying its redirections temporarily
+static void run_builtin(msh_t *shell, stage_t *stage) {
+    int in_fd = STDIN_FILENO, out_fd = STDOUT_FILENO;
+    int saved_in = -1, saved_out = -1;
+
+    if (stage->in_file && (in_fd = open_redirection(stage->in_file, O_RDONLY)) == -1) return;
+    if (stage->out_file && (out_fd = open_redirection(stage->out_file, output_flags(stage))) == -1) {
+        if (in_fd != STDIN_FILENO) close(in_fd);
+        return;
+    }
+
+    fflush(stdout);
+    if (in_fd != STDIN_FILENO) {
+        saved_in = dup(STDIN_FILENO);
+        dup2(in_fd, STDIN_FILENO);
+        close(in_fd);
+    }
+    if (out_fd != STDOUT_FILENO) {
+        saved_out = dup(STDOUT_FILENO);
+        dup2(out_fd, STDOUT_FILENO);
+        close(out_fd);
+    }
+
+    char *rerun_cmd = stage->builtin->handler(stage->argc, stage->argv);
+
+    fflush(stdout);
+    if (saved_in != -1) {
+        dup2(saved_in, STDIN_FILENO);
+        close(saved_in);
+    }
+    if (saved_out != -1) {
+        dup2(saved_out, STDOUT_FILENO);
+        close(saved_out);
+    }
+
+    if (rerun_cmd) {
+        evaluate(shell, rerun_cmd); // Re-run command if history expansion (!N)
+    }
+}
+
+// launches a job that has room in the job table (or runs in the shell); returns its process group,
+// or 0 if it started no processes. cpus pins the job (@cpus=); NULL leaves it to the -A policy.
+static pid_t launch_job(msh_t *shell, const char *line, const token_t *tokens, int num_tokens, int job_type,
+                        const sigset_t *child_mask, const cpu_mask_t *cpus) {
+    pipeline_t pipeline;
+    int num_stages = parse_pipeline(tokens, num_tokens, &pipeline, shell->arena);
+    if (num_stages <= 0) return 0;
+    stage_t *stages = pipeline.stages;
+
+    if (num_stages == 1 && stages[0].builtin) {
+        run_builtin(shell, &stages[0]);
+        return 0;
+    }
+
+    cpu_mask_t placed;
+    bool per_stage = false; // -A rr: stage i gets the i-th CPU of the job's mask
+    if (!cpus && job_type == BACKGROUND && place_job(shell->affinity, shell->jobs, num_stages, &placed)) {
+        cpus = &placed;
+        per_stage = shell->affinity == AFFINITY_RR;
+    }
+    // Background processes get the lower class before they exec, so their children have it too (MSH_BG_SCHED)
+    const bg_policy_t *bg_policy = job_type == BACKGROUND ? &shell->bg_policy : NULL;
+
+    pid_t pids[num_stages];
+    int num_pids = 0;
+    pid_t pgid = 0; // the first process started leads the job's process group
+    int prev_read = STDIN_FILENO;
+    fflush(stdout); // output the shell buffered so far must come before the job's own
+
+    for (int i = 0; i < num_stages; i++) {
+        stage_t *stage = &stages[i];
+        int pipe_fds[2] = {-1, -1};
+        if (i < num_stages - 1 && pipe2(pipe_fds, O_CLOEXEC) == -1) {
+            perror("pipe");
+            break;
+        }
+
+        int in_fd = prev_read;
+        int out_fd = (i < num_stages - 1) ? pipe_fds[1] : STDOUT_FILENO;
+        int file_in = -1, file_out = -1;
+        bool ready = true;
+        if (stage->in_file) { // a redirection overrides the pipe
+            file_in = open_redirection(stage->in_file, O_RDONLY);
+            in_fd = file_in;
+            ready = file_in != -1;
+        }
+        if (ready && stage->out_file) {
+            file_out = open_redirection(stage->out_file, output_flags(stage));
+            out_fd = file_out;
+            ready = file_out != -1;
+        }
+
+        if (ready) {
+            pid_t pid;
+            cpu_mask_t stage_mask;
+            const cpu_mask_t *stage_cpus = cpus;
+            if (per_stage) {
+                nth_cpu(cpus, i, &stage_mask);
+                stage_cpus = &stage_mask;
+            }
+            if (stage->builtin) {
+                pid = launch_builtin(stage, pgid, child_mask, in_fd, out_fd, stage_cpus, bg_policy);
+            } else {
+                // Resolve argv[0] in the parent so the lookup is cached across launches
+                const char *exec_path = resolve_path(shell->path_cache, stage->argv[0]);
+                if (!exec_path) exec_path = stage->argv[0]; // not in PATH: let execve report the error
+                TRACE(TRACE_PATH_RESOLVED, i);
+                pid = launch_process(shell->launch_backend, exec_path, stage->argv, pgid, child_mask,
+                                     in_fd, out_fd, stage_cpus, bg_policy);
+            }
+            if (pid > 0) {
+                TRACE(TRACE_LAUNCHED, pid);
+                if (pgid == 0) pgid = pid;
+                pids[num_pids++] = pid;
+            }
+        }
+
+        // The children hold their own copies now
+        if (file_in != -1) close(file_in);
+        if (file_out != -1) close(file_out);
+        if (prev_read != STDIN_FILENO) close(prev_read);
+        if (pipe_fds[1] != -1) close(pipe_fds[1]);
+        prev_read = pipe_fds[0] != -1 ? pipe_fds[0] : STDIN_FILENO;
+    }
+    if (prev_read != STDIN_FILENO) close(prev_read);
+
+    if (num_pids > 0) {
+        // Add the job and handle foreground/background
+        // The job table keeps the job's text as typed, quotes included
+        int start = tokens[0].start, end = tokens[num_tokens - 1].end;
+        char *cmd_line = arena_strndup(shell->arena, line + start, end - start);
+        if (!cmd_line) cmd_line = "";
+
+        bool tracked = add_job(shell->jobs, pgid, pids, num_pids,
+                               (job_type == BACKGROUND) ? BACKGROUND : FOREGROUND, cmd_line);
+        job_t *job = tracked ? get_job_by_pid(shell->jobs, pgid) : NULL;
+        if (job && cpus) { // jobs -v shows it (all stages together), and -A places later jobs around it
+            job->pinned = true;
+            job->cpus = *cpus;
+        }
+        if (!tracked && job_type == BACKGROUND) {
+            fprintf(stderr, "error: job table full (%d jobs), [%d] is not tracked; set %s=1 to grow it\n",
+                    shell->jobs->max_jobs, pgid, JOBS_GROW_ENV);
+        }
+        if (job_type == FOREGROUND) {
+            if (tracked) {
+                waitfg(pgid); // Wait for every stage of the foreground job
+            } else {
+                for (int i = 0; i < num_pids; i++) { // job table full: nobody else will reap them
+                    int status;
+                    waitpid(pids[i], &status, WUNTRACED);
+                }
+            }
+        }
+    }
+    return pgid;
+}
+
+// prints seconds the way the time keyword does: 0m0.000s
+static void print_seconds(const char *label, double seconds) {
+    fprintf(stderr, "%s\t%dm%.3fs\n", label, (int)(seconds / 60), seconds - 60 * (int)(seconds / 60));
+}
+
+static double timeval_seconds(const struct timeval *tv) {
+    return tv->tv_sec + tv->tv_usec / 1e6;
+}
+
+// adds after - before to total
+static void add_difference(struct timeval *total, const struct timeval *after, const struct timeval *before) {
+    struct timeval diff;
+    timersub(after, before, &diff);
+    timeradd(total, &diff, total);
+}
+
+// runs a foreground job and reports its real time and resource usage on stderr
+static void time_job(msh_t *shell, const char *line, const token_t *tokens, int num_tokens,
+                     const sigset_t *child_mask, const cpu_mask_t *cpus) {
+    struct timespec start, end;
+    struct rusage self_before, children_before, self_after, children_after;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    getrusage(RUSAGE_SELF, &self_before);
+    getrusage(RUSAGE_CHILDREN, &children_before);
+
+    pid_t pgid = launch_job(shell, line, tokens, num_tokens, FOREGROUND, child_mask, cpus);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    getrusage(RUSAGE_SELF, &self_after);
+    getrusage(RUSAGE_CHILDREN, &children_after);
+
+    // The job's own accounting when it ran to completion; otherwise (a builtin, a stopped or untracked
+    // job) what the shell and its reaped children used meanwhile
+    const finished_job_t *finished = pgid ? get_finished_job(shell->jobs, pgid) : NULL;
+    struct rusage usage;
+    if (finished) {
+        usage = finished->usage.rusage;
+    } else {
+        memset(&usage, 0, sizeof(usage));
+        add_difference(&usage.ru_utime, &self_after.ru_utime, &self_before.ru_utime);
+        add_difference(&usage.ru_utime, &children_after.ru_utime, &children_before.ru_utime);
+        add_difference(&usage.ru_stime, &self_after.ru_stime, &self_before.ru_stime);
+        add_difference(&usage.ru_stime, &children_after.ru_stime, &children_before.ru_stime);
+        usage.ru_maxrss = pgid ? children_after.ru_maxrss : self_after.ru_maxrss; // a builtin ran in the shell
+        usage.ru_nvcsw = self_after.ru_nvcsw - self_before.ru_nvcsw +
+                         children_after.ru_nvcsw - children_before.ru_nvcsw;
+        usage.ru_nivcsw = self_after.ru_nivcsw - self_before.ru_nivcsw +
+                          children_after.ru_nivcsw - children_before.ru_nivcsw;
+    }
+
+    fputc('\n', stderr);
+    print_seconds("real", elapsed_seconds(&start, &end));
+    print_seconds("user", timeval_seconds(&usage.ru_utime));
+    print_seconds("sys", timeval_seconds(&usage.ru_stime));
+    fprintf(stderr, "maxrss\t%ldK\nctxsw\t%ld voluntary, %ld involuntary\n",
+            usage.ru_maxrss, usage.ru_nvcsw, usage.ru_nivcsw);
+}
+
+// The `@name=value` words in front of a job
+typedef struct job_options {
+    int priority;       // @prio=N: the admission priority of a queued background job
+    bool pinned;        // @cpus=LIST was given
+    cpu_mask_t cpus;    // The CPUs of @cpus=LIST
+} job_options_t;
+
+// reads the `@name=value` words in front of a job; returns the number of tokens they take up, or -1 if
+// one is invalid (the error is printed)
+static int parse_job_options(const token_t *tokens, int num_tokens, job_options_t *options) {
+    int t = 0;
+    options->priority = 0;
+    options->pinned = false;
+    for (; t < num_tokens && tokens[t].type == TOK_WORD; t++) {
+        const char *word = tokens[t].text;
+        if (strncmp(word, PRIORITY_OPTION, strlen(PRIORITY_OPTION)) == 0) {
+            options->priority = atoi(word + strlen(PRIORITY_OPTION));
+        } else if (strncmp(word, CPUS_OPTION, strlen(CPUS_OPTION)) == 0) {
+            if (!parse_cpu_list(word + strlen(CPUS_OPTION), &options->cpus)) {
+                fprintf(stderr, "error: invalid CPU list: %s\n", word + strlen(CPUS_OPTION));
+                return -1;
+            }
+            if (!usable_cpus(&options->cpus)) {
+                fprintf(stderr, "error: none of CPUs %s are available\n", word + strlen(CPUS_OPTION));
+                return -1;
+            }
+            options->pinned = true;
+        } else {
+            break;
+        }
+    }
+    return t;
+}
+
+// true if the job is a lone builtin, which runs in the shell and takes no job table slot
+static bool runs_in_shell(const token_t *tokens, int num_tokens) {
+    if (num_tokens == 0 || tokens[0].type != TOK_WORD || !find_builtin(tokens[0].text)) return false;
+    for (int t = 1; t < num_tokens; t++) {
+        if (tokens[t].type == TOK_PIPE) return false;
+    }
+    return true;
+}
+
+void run_job(msh_t *shell, const char *line, const token_t *tokens, int num_tokens, int job_type,
+             const sigset_t *child_mask) {
+    job_options_t options;
+    int skip = parse_job_options(tokens, num_tokens, &options);
+    if (skip < 0) return;
+    const cpu_mask_t *cpus = options.pinned ? &options.cpus : NULL;
+    if (job_type == BACKGROUND && !runs_in_shell(tokens + skip, num_tokens - skip) &&
+        (shell->queue->count > 0 || job_table_full(shell->jobs))) {
+        // No room (or jobs queued ahead of it): the job waits its turn without being forked
+        int start = tokens[0].start, end = tokens[num_tokens - 1].end;
+        char *text = arena_strndup(shell->arena, line + start, end - start);
+        if (!text || !enqueue_job(shell->queue, text, options.priority)) return;
+        admit_queued_jobs(shell);
+        return;
+    }
+    if (job_type == FOREGROUND && skip < num_tokens && tokens[skip].type == TOK_WORD &&
+        strcmp(tokens[skip].text, TIME_KEYWORD) == 0 && skip + 1 < num_tokens) {
+        time_job(shell, line, tokens + skip + 1, num_tokens - skip - 1, child_mask, cpus);
+        return;
+    }
+    launch_job(shell, line, tokens + skip, num_tokens - skip, job_type, child_mask, cpus);
+}
+
+void admit_queued_jobs(msh_t *shell) {
+    while (shell->queue->count > 0 && !job_table_full(shell->jobs)) {
+        char *text = dequeue_job(shell->queue);
+        lexer_t lex;
+        int num_tokens = lex_line(&lex, text, shell->arena);
+        if (num_tokens > 0) {
+            job_options_t options;
+            int skip = parse_job_options(lex.tokens, num_tokens, &options);
+            if (skip >= 0) {
+                launch_job(shell, text, lex.tokens + skip, num_tokens - skip, BACKGROUND, child_signal_mask(),
+                           options.pinned ? &options.cpus : NULL);
+            }
+        }
+        lex_free(&lex);
+        free(text);
+    }
+}
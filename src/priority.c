@@ -0,0 +1,82 @@
+#define _GNU_SOURCE     // For SCHED_BATCH and SCHED_IDLE
+#include "priority.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/resource.h> // For setpriority
+#include <sys/syscall.h>  // For SYS_ioprio_set
+
+// ioprio_set(2) has no glibc wrapper or header
+#define IOPRIO_WHO_PROCESS 1
+#define IOPRIO_WHO_PGRP 2
+#define IOPRIO_CLASS_SHIFT 13
+#define IOPRIO_VALUE(class, level) ((class) << IOPRIO_CLASS_SHIFT | (level))
+#define IOPRIO_CLASS_NONE 0     // Follow the CPU nice level
+#define IOPRIO_CLASS_BE 2
+#define IOPRIO_CLASS_IDLE 3
+
+void read_bg_policy(bg_policy_t *policy) {
+    memset(policy, 0, sizeof(*policy));
+    errno = 0;
+    int nice = getpriority(PRIO_PROCESS, 0);
+    policy->fg_nice = errno ? 0 : nice;
+
+    const char *class = getenv(BG_SCHED_ENV);
+    if (!class || !*class || strcmp(class, "normal") == 0) return;
+    if (strcmp(class, "batch") == 0) {
+        policy->sched = SCHED_BATCH;
+        policy->nice = 10;
+        policy->ioprio = IOPRIO_VALUE(IOPRIO_CLASS_BE, 7);
+    } else if (strcmp(class, "idle") == 0) {
+        policy->sched = SCHED_IDLE;
+        policy->nice = 19;
+        policy->ioprio = IOPRIO_VALUE(IOPRIO_CLASS_IDLE, 0);
+    } else {
+        fprintf(stderr, "error: %s=%s is not batch, idle or normal; background jobs keep normal priority\n",
+                BG_SCHED_ENV, class);
+        return;
+    }
+    const char *nice_env = getenv(BG_NICE_ENV);
+    if (nice_env && *nice_env) policy->nice = atoi(nice_env);
+    if (policy->nice < policy->fg_nice) policy->nice = policy->fg_nice; // never above the shell
+    if (policy->nice > 19) policy->nice = 19;
+    policy->enabled = true;
+}
+
+int apply_bg_policy(const bg_policy_t *policy, pid_t pid) {
+    if (!policy->enabled) return 0;
+    struct sched_param param = { .sched_priority = 0 };
+    if (sched_setscheduler(pid, policy->sched, &param) == -1) return -1;
+    if (setpriority(PRIO_PROCESS, pid, policy->nice) == -1) return -1;
+#ifdef SYS_ioprio_set
+    if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, pid, policy->ioprio) == -1) return -1;
+#endif
+    return 0;
+}
+
+int prioritize_job(const bg_policy_t *policy, const job_t *job, bool background) {
+    if (!policy->enabled) return 0;
+    int first_error = 0;
+    struct sched_param param = { .sched_priority = 0 };
+    int sched = background ? policy->sched : SCHED_OTHER;
+    for (int p = 0; p < job->nprocs; p++) {
+        if (job->procs[p] != 0 && sched_setscheduler(job->procs[p], sched, &param) == -1 &&
+            errno != ESRCH && !first_error) { // ESRCH: it exited meanwhile
+            first_error = errno;
+        }
+    }
+    if (setpriority(PRIO_PGRP, job->pid, background ? policy->nice : policy->fg_nice) == -1 &&
+        errno != ESRCH && !first_error) {
+        first_error = errno;
+    }
+#ifdef SYS_ioprio_set
+    int ioprio = background ? policy->ioprio : IOPRIO_VALUE(IOPRIO_CLASS_NONE, 0);
+    if (syscall(SYS_ioprio_set, IOPRIO_WHO_PGRP, job->pid, ioprio) == -1 && errno != ESRCH && !first_error) {
+        first_error = errno;
+    }
+#endif
+    return first_error;
+}
@@ -5,13 +5,18 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <ctype.h>      // For isspace
-#include <unistd.h>     // For fork, execve
+#include <unistd.h>
 #include <sys/types.h>  // For pid_t
 #include <sys/wait.h>   // For waitpid
 #include <errno.h>      // For perror
 #include <signal.h>
+#include <time.h>       // For clock_gettime
 #include "history.h"
 #include "signal_handlers.h"
+#include "pipeline.h"
+#include "lexer.h"
+#include "builtins.h"
+#include "trace.h"
 
 msh_t *shell = NULL;
 
@@ -28,7 +33,19 @@ msh_t *alloc_shell(int max_jobs, int max_line, int max_history) {
     shell_state->max_line = max_line;
     shell_state->max_history = max_history;
 
-    shell_state->jobs = calloc(max_jobs, sizeof(job_t)); // allocate memory for jobs
+    // the zygote forks now, while the shell is small, so each launch copies only this address space
+    shell_state->notify_now = false;
+    shell_state->input = NULL;
+    shell_state->affinity = AFFINITY_NONE;
+    read_bg_policy(&shell_state->bg_policy);
+    shell_state->launch_backend = launch_backend_from_env();
+    if (shell_state->launch_backend == LAUNCH_ZYGOTE && !start_zygote()) {
+        shell_state->launch_backend = LAUNCH_SPAWN;
+    }
+
+    // allocate the job table; with MSH_GROW_JOBS set it grows past max_jobs instead of filling up
+    const char *grow = getenv(JOBS_GROW_ENV);
+    shell_state->jobs = alloc_jobs(max_jobs, grow && *grow && strcmp(grow, "0") != 0);
     if (!shell_state->jobs) {
         free(shell_state); // free shell state if job allocation fails
         return NULL;
@@ -37,22 +54,100 @@ msh_t *alloc_shell(int max_jobs, int max_line, int max_history) {
 // Allocate history for the shell
     shell_state->history = alloc_history(max_history);
     if (!shell_state->history) {
-        free_jobs(shell_state->jobs, max_jobs);
+        free_jobs(shell_state->jobs);
         free(shell_state);
         return NULL;
     }
 
+    shell_state->path_cache = alloc_path_cache();
+    if (!shell_state->path_cache) {
+        free_history(shell_state->history);
+        free_jobs(shell_state->jobs);
+        free(shell_state);
+        return NULL;
+    }
 
+    shell_state->arena = alloc_arena();
+    if (!shell_state->arena) {
+        free_path_cache(shell_state->path_cache);
+        free_history(shell_state->history);
+        free_jobs(shell_state->jobs);
+        free(shell_state);
+        return NULL;
+    }
+
+    shell_state->queue = alloc_admission_queue();
+    if (!shell_state->queue) {
+        free_arena(shell_state->arena);
+        free_path_cache(shell_state->path_cache);
+        free_history(shell_state->history);
+        free_jobs(shell_state->jobs);
+        free(shell_state);
+        return NULL;
+    }
 
     initialize_signal_handlers(); // Set up signal handlers
+    trace_init(); // MSH_TRACE turns on the event ring read by `stats`
 
     return shell_state;
 }
 
-// parses commands with &, ;
-static char *current_line = NULL;
-
 // check if string has only whitespace
+bool fill_script_input(script_input_t *input) {
+    if (input->eof) return false;
+    if (input->pos > 0) { // keep only the input nobody has used yet
+        memmove(input->text, input->text + input->pos, input->len - input->pos);
+        input->len -= input->pos;
+        input->pos = 0;
+    }
+    if (input->len == input->cap) { // a line longer than the buffer
+        char *grown = realloc(input->text, input->cap * 2);
+        if (!grown) {
+            perror("realloc");
+            input->eof = true;
+            return false;
+        }
+        input->text = grown;
+        input->cap *= 2;
+    }
+    ssize_t got = read(input->fd, input->text + input->len, input->cap - input->len);
+    if (got == -1) perror("read");
+    if (got <= 0) {
+        input->eof = true;
+        return false;
+    }
+    input->len += got;
+    return true;
+}
+
+ssize_t read_input_line(msh_t *shell, char **line, size_t *cap) {
+    script_input_t *input = shell->input;
+    if (!input) {
+        ssize_t len = getline(line, cap, stdin);
+        if (len > 0 && (*line)[len - 1] == '\n') (*line)[--len] = '\0';
+        return len;
+    }
+
+    const char *end;
+    while (!(end = memchr(input->text + input->pos, '\n', input->len - input->pos)) &&
+           fill_script_input(input)) {}
+    if (!end && input->pos == input->len) return -1;
+    size_t len = (end ? end : input->text + input->len) - (input->text + input->pos);
+    if (len + 1 > *cap) {
+        char *grown = realloc(*line, len + 1);
+        if (!grown) {
+            perror("realloc");
+            return -1;
+        }
+        *line = grown;
+        *cap = len + 1;
+    }
+    memcpy(*line, input->text + input->pos, len);
+    (*line)[len] = '\0';
+    input->pos += len + (end != NULL);
+    return len;
+}
+
 int white_space(const char *str) {
     while (*str) {
         if (!isspace((unsigned char)*str)) return 0; // return 0 if non-whitespace character found
@@ -61,13 +156,9 @@ int white_space(const char *str) {
     return 1; // return 1 if string contains only whitespace
 }
 
-// tokenizes command line into individual jobs
-char *parse_tok(char *line, int *job_type) {
-    static char *current = NULL;
-
-    if (line != NULL) {
-        current = line; // set current to line if line is provided
-    }
+// tokenizes the next job starting at *cursor and advances the cursor past it
+static char *next_job(char **cursor, int *job_type) {
+    char *current = *cursor;
 
     if (!current || *current == '\0') { // check if current is null or empty
         *job_type = -1; // set job type to -1 if no job
@@ -79,6 +170,7 @@ char *parse_tok(char *line, int *job_type) {
     }
 
     if (*current == '\0') { // check if end of line is reached
+        *cursor = current;
         *job_type = -1;
         return NULL;
     }
@@ -104,257 +196,198 @@ char *parse_tok(char *line, int *job_type) {
         *end-- = '\0';
     }
 
+    *cursor = current;
     return start; // return parsed job
 }
 
+// tokenizes command line into individual jobs
+char *parse_tok(char *line, int *job_type) {
+    static char *current = NULL;
+
+    if (line != NULL) {
+        current = line; // set current to line if line is provided
+    }
+    return next_job(&current, job_type);
+}
+
 // separates job into arguments and identifies built-in commands
 char **separate_args(char *line, int *argc, bool *is_builtin) {
+    *argc = 0;
     if (!line || !*line) { // check if line is null or empty
-        *argc = 0;
         return NULL;
     }
 
-    int capacity = 10;
-    char **argv = malloc(capacity * sizeof(char *)); // allocate memory for arguments
-    if (!argv) return NULL; // return null if memory allocation fails
+    lexer_t lex;
+    int num_tokens = lex_line(&lex, line, NULL);
+    char **argv = num_tokens >= 0 ? malloc((num_tokens + 1) * sizeof(char *)) : NULL;
+    if (!argv) {
+        lex_free(&lex);
+        return NULL;
+    }
 
-    *argc = 0;
-    char *token = strtok(line, " \t"); // tokenize line by whitespace
-    while (token) {
-        if (*argc >= capacity) { // double capacity if more space needed
-            capacity *= 2;
-            argv = realloc(argv, capacity * sizeof(char *)); // reallocate memory for arguments
-            if (!argv) {
-                for (int i = 0; i < *argc; i++) free(argv[i]); // free allocated arguments if reallocation fails
-                return NULL;
-            }
+    // Copy the words back over the line (they never take more room than the line), so argv outlives lex
+    char *out = line;
+    for (int i = 0; i < num_tokens; i++) {
+        if (lex.tokens[i].type == TOK_WORD) {
+            size_t len = strlen(lex.tokens[i].text);
+            memmove(out, lex.tokens[i].text, len + 1);
+            argv[i] = out;
+            out += len + 1;
+        } else {
+            argv[i] = lex.tokens[i].text; // the operator's spelling
         }
-        argv[(*argc)++] = token; // add token to argument list
-        token = strtok(NULL, " \t"); // get next token
     }
+    lex_free(&lex);
 
+    *argc = num_tokens;
     argv[*argc] = NULL; // terminate argument list
-    *is_builtin = false; // set built-in flag to false
+    *is_builtin = *argc > 0 && find_builtin(argv[0]) != NULL; // flag commands in the builtin registry
     return argv;
 }
 
+// blocks until the foreground job leaves the foreground (reaped or stopped)
 void waitfg(pid_t pid) {
-    int status;
-    while (1) {
-        pid_t finished = waitpid(pid, &status, WNOHANG);
-        if (finished == pid) break;  // Foreground job has completed
-        if (finished == -1) {
+    job_t *job = get_job_by_pid(shell->jobs, pid);
+    if (!job) { // untracked job (job table full): nobody else will reap it
+        int status;
+        if (waitpid(pid, &status, WUNTRACED) == -1 && errno != ECHILD) {
             perror("waitpid");
-            break;
         }
-        usleep(100000); // Sleep for 100ms before checking again
+        return;
+    }
+
+    // Child state changes arrive on the signal event fd; handle them until this job is done or stopped
+    while ((job = get_job_by_pid(shell->jobs, pid)) && job->state == FOREGROUND) {
+        wait_signal_events(-1);
+        admit_queued_jobs(shell); // slots freed by background jobs are reused right away
+    }
+}
+
+void report_completions(msh_t *shell) {
+    job_table_t *jobs = shell->jobs;
+    for (int i = 0; i < jobs->num_completions; i++) {
+        const completion_t *completion = &jobs->completions[i];
+        printf("[%d] %d DONE %s\n", completion->jid, completion->pid,
+               completion->cmd_line ? completion->cmd_line : "");
+    }
+    if (jobs->num_completions > 0) {
+        fflush(stdout);
+        clear_completions(jobs);
     }
 }
 
 // executes command
 int evaluate(msh_t *shell, char *line) {
-    sigset_t mask, prev_mask;
-
-    // Block SIGCHLD to prevent race conditions with signal handlers
-    sigemptyset(&mask);
-    sigaddset(&mask, SIGCHLD);
-    sigprocmask(SIG_BLOCK, &mask, &prev_mask);
-
     // Add the command line to history (unless it's empty or "exit")
     if (strlen(line) > 0 && strcmp(line, "exit") != 0) {
         add_line_history(shell->history, line);
     }
 
-    // Parse the command line into jobs
-    int job_type;
-    char *job = parse_tok(line, &job_type);
-
-    while (job && strlen(job) > 0) {
-        int argc;
-        bool is_builtin;
-        char **argv = separate_args(job, &argc, &is_builtin);
-
-        if (argv) {
-            if (is_builtin) {
-                // Handle built-in commands
-                char *rerun_cmd = builtin_cmd(argc, argv);
-                if (rerun_cmd) {
-                    evaluate(shell, rerun_cmd); // Re-run command if history expansion (!N)
-                    free(rerun_cmd);           // Free the returned command
-                }
-            } else {
-                pid_t pid = fork();
-                if (pid == 0) {
-                    // Child process: Create a new process group and unblock signals
-                    setpgid(0, 0);
-                    sigprocmask(SIG_SETMASK, &prev_mask, NULL);
-
-                    // Search for the command in PATH if it's not an absolute path
-                    extern char **environ;  // Use the current environment
-                    char *path = getenv("PATH");
-                    if (path && strchr(argv[0], '/') == NULL) {
-                        char *dir, *full_path;
-                        char *path_copy = strdup(path);
-                        dir = strtok(path_copy, ":");
-                        while (dir) {
-                            full_path = malloc(strlen(dir) + strlen(argv[0]) + 2);
-                            sprintf(full_path, "%s/%s", dir, argv[0]);
-                            if (access(full_path, X_OK) == 0) {
-                                execve(full_path, argv, environ);
-                                perror("execve");
-                                free(full_path);
-                                break;
-                            }
-                            free(full_path);
-                            dir = strtok(NULL, ":");
-                        }
-                        free(path_copy);
-                    }
-
-                    // If the command is an absolute path or wasn't found in PATH
-                    execve(argv[0], argv, environ);
-                    perror("execve");  // If execve fails, report an error
-                    exit(EXIT_FAILURE); // Exit if execution fails
-                } else if (pid > 0) {
-                    // Parent process: Add the job and handle foreground/background
-                    add_job(shell->jobs, shell->max_jobs, pid, 
-                            (job_type == BACKGROUND) ? BACKGROUND : FOREGROUND, job);
-
-                    if (job_type == FOREGROUND) {
-                        waitfg(pid); // Wait for the foreground job to complete
-                    }
-                } else {
-                    perror("fork"); // Handle fork failure
-                }
-            }
-            free(argv); // Free the argument array
+    // Lex the whole line once, then run each `;` or `&` terminated job (re-runs of !N call evaluate
+    // recursively with a lexer of their own)
+    lexer_t lex;
+    if (lex_line(&lex, line, shell->arena) == -1) {
+        lex_free(&lex);
+        return -1;
+    }
+    TRACE(TRACE_PARSED, 0);
+
+    int first = 0;
+    for (int i = 0; i <= lex.num_tokens; i++) {
+        token_type_t type = lex.tokens[i].type;
+        if (type != TOK_SEMI && type != TOK_AMP && type != TOK_END) continue;
+        if (i > first) { // skip empty jobs
+            run_job(shell, line, &lex.tokens[first], i - first, type == TOK_AMP ? BACKGROUND : FOREGROUND,
+                    child_signal_mask());
         }
-        job = parse_tok(NULL, &job_type); // Get the next job in the command line
+        first = i + 1;
     }
-
-    // Unblock SIGCHLD signals after adding the job
-    sigprocmask(SIG_SETMASK, &prev_mask, NULL);
+    lex_free(&lex);
     return 0;
 }
 
-
-
-
-char *builtin_cmd(int argc, char **argv) {
-    // Command: jobs
-    if (strcmp(argv[0], "jobs") == 0) {
-        for (int i = 0; i < shell->max_jobs; i++) {
-            if (shell->jobs[i].state != UNDEFINED) {
-                printf("[%d] %d %s %s\n",
-                       shell->jobs[i].jid,
-                       shell->jobs[i].pid,
-                       shell->jobs[i].state == BACKGROUND ? "RUNNING" : "STOPPED",
-                       shell->jobs[i].cmd_line);
-            }
-        }
-        return NULL;
-    }
-
-    // Command: history
-    if (strcmp(argv[0], "history") == 0) {
-        if (shell->history) {
-            print_history(shell->history);
-        } else {
-            fprintf(stderr, "error: history is not initialized.\n");
-        }
-        return NULL;
-    }
-
-    // Command: !N (History expansion)
-    if (argv[0][0] == '!' && isdigit(argv[0][1])) {
-        int index = atoi(&argv[0][1]);
-        if (shell->history) {
-            char *cmd = find_line_history(shell->history, index);
-            if (cmd) {
-                printf("%s\n", cmd); // Show the command being executed
-                return cmd; // Return the command for re-execution
-            }
-        }
-        fprintf(stderr, "error: invalid or out-of-range history index\n");
-        return NULL;
+// true if any job is running in the background
+static bool background_running(const msh_t *shell) {
+    for (int i = 0; i < shell->jobs->capacity; i++) {
+        if (shell->jobs->jobs[i].state == BACKGROUND) return true;
     }
+    return false;
+}
 
-    // Commands: bg or fg
-    if ((strcmp(argv[0], "bg") == 0 || strcmp(argv[0], "fg") == 0) && argc > 1) {
-        if (argv[1][0] == '%') {
-            int jid = atoi(&argv[1][1]); // Parse job ID
-            for (int i = 0; i < shell->max_jobs; i++) {
-                if (shell->jobs[i].jid == jid && shell->jobs[i].state != UNDEFINED) {
-                    kill(-shell->jobs[i].pid, SIGCONT); // Send SIGCONT to the job's process group
-                    if (strcmp(argv[0], "fg") == 0) {
-                        shell->jobs[i].state = FOREGROUND;
-                        waitfg(shell->jobs[i].pid); // Wait for foreground job to complete
-                    } else if (strcmp(argv[0], "bg") == 0) {
-                        shell->jobs[i].state = BACKGROUND;
-                        printf("[%d] %d %s\n", shell->jobs[i].jid, shell->jobs[i].pid, "RUNNING");
-                    }
-                    return NULL;
-                }
-            }
-            fprintf(stderr, "error: job ID %d not found\n", jid);
-        } else {
-            fprintf(stderr, "error: invalid job ID format. Use %%<JOB_ID>\n");
-        }
-        return NULL;
+// sends sig to the process group of every background job; returns the number of jobs
+static int signal_background_jobs(msh_t *shell, int sig) {
+    int count = 0;
+    for (int i = 0; i < shell->jobs->capacity; i++) {
+        if (shell->jobs->jobs[i].state != BACKGROUND) continue;
+        count++;
+        if (sig && kill(-shell->jobs->jobs[i].pid, sig) == -1) perror("kill");
     }
+    return count;
+}
 
-    // Command: kill
-    if (strcmp(argv[0], "kill") == 0 && argc == 3) {
-        int sig_num = atoi(argv[1]);
-        pid_t pid = atoi(argv[2]);
-
-        // Validate signal number
-        if (sig_num != SIGINT && sig_num != SIGKILL && sig_num != SIGCONT && sig_num != SIGSTOP) {
-            fprintf(stderr, "error: invalid signal number. Allowed: 2(SIGINT), 9(SIGKILL), 18(SIGCONT), 19(SIGSTOP)\n");
-            return NULL;
-        }
-
-        if (kill(pid, sig_num) == -1) {
-            perror("kill");
-        }
-        return NULL;
+// sets deadline to seconds from now
+static void set_deadline(struct timespec *deadline, double seconds) {
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    deadline->tv_sec += (time_t)seconds;
+    deadline->tv_nsec += (long)((seconds - (time_t)seconds) * 1e9);
+    if (deadline->tv_nsec >= 1000000000) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000;
     }
-
-    // Unknown command
-    return NULL;
 }
 
-
-
-
+// milliseconds until deadline (0 if it has passed), or -1 for no deadline
+static int ms_until(const struct timespec *deadline) {
+    if (deadline->tv_sec == 0) return -1;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long ms = (deadline->tv_sec - now.tv_sec) * 1000 + (deadline->tv_nsec - now.tv_nsec) / 1000000;
+    return ms > 0 ? (int)ms : 0;
+}
 
 // free shell memory
 void exit_shell(msh_t *shell) {
-    int status;
-    int background_jobs_found = 0;
-
-    // Wait for all background jobs to complete
-    for (int i = 0; i < shell->max_jobs; i++) {
-        if (shell->jobs[i].state == BACKGROUND) {
-            background_jobs_found = 1; // Indicate that we found background jobs
-            pid_t bg_pid = shell->jobs[i].pid;
-
-            printf("Waiting for background job (PID: %d) to complete...\n", bg_pid);
-            // Block until the job completes
-            waitpid(bg_pid, &status, 0); //wait
-
-            // Job has completed
-            printf("Background job (PID: %d) completed.\n", bg_pid);
-            delete_job(shell->jobs, shell->max_jobs, bg_pid);
+    const char *grace_env = getenv(EXIT_GRACE_ENV);
+    double grace = grace_env ? atof(grace_env) : 0;
+    struct timespec deadline = {0, 0}; // no deadline
+    if (grace > 0) set_deadline(&deadline, grace);
+
+    // Wait for every background job at once; queued jobs still run as slots free up
+    int signals_sent = 0;
+    for (;;) {
+        arena_reset(shell->arena); // admitted jobs are parsed in it
+        admit_queued_jobs(shell);
+        if (!background_running(shell)) {
+            if (shell->queue->count > 0) { // every slot holds a stopped job, so no slot will free up
+                fprintf(stderr, "error: %d queued jobs were never started\n", shell->queue->count);
+            }
+            break;
         }
-    }
-
-    // If no background jobs were found, ensure an artificial delay to meet timing constraints
-    if (!background_jobs_found) {
-        usleep(500000); // Delay of 0.5 seconds
+        int timeout = ms_until(&deadline);
+        if (timeout == 0) { // out of grace: SIGTERM first, SIGKILL the next time, then give up
+            if (shell->queue->count > 0) {
+                fprintf(stderr, "error: %d queued jobs were never started\n", shell->queue->count);
+                while (shell->queue->count > 0) free(dequeue_job(shell->queue));
+            }
+            if (signals_sent == 2) { // stopped past SIGKILL's reach, or never reaped
+                fprintf(stderr, "error: %d background jobs did not exit after SIGKILL\n",
+                        signal_background_jobs(shell, 0));
+                break;
+            }
+            signal_background_jobs(shell, signals_sent == 0 ? SIGTERM : SIGKILL);
+            signals_sent++;
+            set_deadline(&deadline, grace);
+            continue;
+        }
+        wait_signal_events(timeout);
     }
 
     // Free resources
-    free_jobs(shell->jobs, shell->max_jobs);
+    stop_zygote();
+    free_history(shell->history); // compacts and syncs the journal
+    free_path_cache(shell->path_cache);
+    free_jobs(shell->jobs);
+    free_arena(shell->arena);
+    free_admission_queue(shell->queue);
     free(shell);
 }
\ No newline at end of file
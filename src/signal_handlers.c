@@ -1,88 +1,91 @@
+#define _GNU_SOURCE     // For pipe2
 #include "signal_handlers.h"
 #include "shell.h"
 #include "job.h"
+#include "trace.h"
 #include <signal.h>
 #include <sys/wait.h>
+#include <sys/resource.h> // For wait4
 #include <stdio.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <unistd.h>
 #include <stdlib.h> // Include for exit()
 
+#if defined(__linux__) && !defined(MSH_NO_SIGNALFD)
+#include <sys/signalfd.h>
+#define HAVE_SIGNALFD 1
+#endif
+
 extern msh_t *shell; // Access the global shell state
 
+static int event_fd = -1;        // signalfd, or the read end of the self-pipe
+static int self_pipe[2] = {-1, -1};
+static sigset_t shell_signals;   // SIGCHLD, SIGINT and SIGTSTP
+static sigset_t initial_mask;    // the mask before the shell blocked its signals
+static bool interrupted = false; // a SIGINT arrived with no foreground job to take it
+
 /*
- * sigchld_handler - The kernel sends a SIGCHLD to the shell whenever
- *     a child job terminates (becomes a zombie), or stops because it
- *     received a SIGSTOP or SIGTSTP signal. The handler reaps all
- *     available zombie children, but doesn't wait for any other
- *     currently running children to terminate.
+ * reap_children - Reaps every child that has exited, stopped or continued
+ *     and updates the job table, including the exit status and resource
+ *     usage wait4 reports. Runs in the REPL, never in a signal
+ *     handler, so it may free job table entries and report errors.
  */
-void sigchld_handler(int sig) {
+void reap_children(void) {
     int status;
     pid_t pid;
+    struct rusage rusage;
 
-    // Reap all available zombie children
-    while ((pid = waitpid(-1, &status, WNOHANG | WUNTRACED | WCONTINUED)) > 0) {
-        if (WIFEXITED(status)) {
-            printf("DEBUG: Child process (PID: %d) exited normally.\n", pid);
-            delete_job(shell->jobs, shell->max_jobs, pid);
-        } else if (WIFSIGNALED(status)) {
-            printf("DEBUG: Child process (PID: %d) terminated by signal %d.\n", pid, WTERMSIG(status));
-            delete_job(shell->jobs, shell->max_jobs, pid);
+    while ((pid = wait4(-1, &status, WNOHANG | WUNTRACED | WCONTINUED, &rusage)) > 0) {
+        if (WIFEXITED(status) || WIFSIGNALED(status)) {
+            TRACE(TRACE_REAPED, pid);
+            job_t *job = get_job_by_pid(shell->jobs, pid);
+            if (job && job_process_exited(shell->jobs, job, pid, status, &rusage)) { // last process of the pipeline
+                delete_job(shell->jobs, job->pid);
+            }
         } else if (WIFSTOPPED(status)) {
-            printf("DEBUG: Child process (PID: %d) stopped by signal %d.\n", pid, WSTOPSIG(status));
-            job_t *job = get_job_by_pid(shell->jobs, shell->max_jobs, pid);
+            job_t *job = get_job_by_pid(shell->jobs, pid);
             if (job) {
-                job->state = SUSPENDED;
+                set_job_state(shell->jobs, job, SUSPENDED);
             }
         } else if (WIFCONTINUED(status)) {
-            printf("DEBUG: Child process (PID: %d) continued.\n", pid);
-            job_t *job = get_job_by_pid(shell->jobs, shell->max_jobs, pid);
-            if (job) {
-                job->state = BACKGROUND;
+            job_t *job = get_job_by_pid(shell->jobs, pid);
+            if (job && job->state == SUSPENDED) { // fg already marked the job FOREGROUND
+                set_job_state(shell->jobs, job, BACKGROUND);
             }
         }
     }
 
     if (pid == -1 && errno != ECHILD) {
-        perror("waitpid");
+        perror("wait4");
     }
+    if (shell->notify_now) report_completions(shell); // set -b
 }
 
 /*
- * sigint_handler - The kernel sends a SIGINT to the shell whenever the
- *    user types ctrl-c at the keyboard. Catch it and send it along
- *    to the foreground job.
+ * forward_to_foreground - Ctrl+C and Ctrl+Z are meant for the
+ *     foreground job, not the shell: pass them along to its group.
+ *     Returns false if there is no foreground job.
  */
-void sigint_handler(int sig) {
-    printf("DEBUG: Caught SIGINT (Ctrl+C).\n");
-
-    // Find the foreground job and send it the SIGINT signal
-    job_t *fg_job = get_foreground_job(shell->jobs, shell->max_jobs);
-    if (fg_job) {
-        printf("DEBUG: Sending SIGINT to foreground job (PID: %d).\n", fg_job->pid);
-        if (kill(-fg_job->pid, SIGINT) == -1) {
-            perror("kill");
-        }
+static bool forward_to_foreground(int sig) {
+    job_t *fg_job = get_foreground_job(shell->jobs);
+    if (fg_job && kill(-fg_job->pid, sig) == -1) {
+        perror("kill");
     }
+    return fg_job != NULL;
 }
 
 /*
- * sigtstp_handler - The kernel sends a SIGTSTP to the shell whenever
- *     the user types ctrl-z at the keyboard. Catch it and suspend the
- *     foreground job by sending it a SIGTSTP signal.
+ * self_pipe_handler - Fallback when signalfd is unavailable: record the
+ *     signal number in the self-pipe and return. write() is
+ *     async-signal-safe; everything else happens in handle_signal_events.
  */
-void sigtstp_handler(int sig) {
-    printf("DEBUG: Caught SIGTSTP (Ctrl+Z).\n");
-
-    // Find the foreground job and send it the SIGTSTP signal
-    job_t *fg_job = get_foreground_job(shell->jobs, shell->max_jobs);
-    if (fg_job) {
-        printf("DEBUG: Sending SIGTSTP to foreground job (PID: %d).\n", fg_job->pid);
-        if (kill(-fg_job->pid, SIGTSTP) == -1) {
-            perror("kill");
-        }
-    }
+static void self_pipe_handler(int sig) {
+    int olderrno = errno;
+    unsigned char signo = sig;
+    (void)!write(self_pipe[1], &signo, 1); // a full pipe already has a wakeup pending
+    errno = olderrno;
 }
 
 /*
@@ -92,7 +95,7 @@ void sigtstp_handler(int sig) {
  */
 typedef void handler_t(int);
 
-handler_t *setup_handler(int signum, handler_t *handler) {
+static handler_t *setup_handler(int signum, handler_t *handler) {
     struct sigaction action, old_action;
 
     action.sa_handler = handler;
@@ -108,10 +111,95 @@ handler_t *setup_handler(int signum, handler_t *handler) {
 }
 
 /*
- * initialize_signal_handlers - Sets up all the signal handlers for the shell
+ * initialize_signal_handlers - Routes the shell's signals to event_fd
  */
 void initialize_signal_handlers() {
-    setup_handler(SIGCHLD, sigchld_handler); /* Handles child process events */
-    setup_handler(SIGINT, sigint_handler);  /* Handles Ctrl+C */
-    setup_handler(SIGTSTP, sigtstp_handler); /* Handles Ctrl+Z */
+    if (event_fd != -1) return;
+
+    sigemptyset(&shell_signals);
+    sigaddset(&shell_signals, SIGCHLD); /* Child process events */
+    sigaddset(&shell_signals, SIGINT);  /* Ctrl+C */
+    sigaddset(&shell_signals, SIGTSTP); /* Ctrl+Z */
+    sigprocmask(SIG_BLOCK, NULL, &initial_mask);
+
+#ifdef HAVE_SIGNALFD
+    // Keep the signals blocked for good so they queue on the signalfd instead of being delivered
+    sigprocmask(SIG_BLOCK, &shell_signals, NULL);
+    event_fd = signalfd(-1, &shell_signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (event_fd != -1) return;
+    perror("signalfd");
+    sigprocmask(SIG_SETMASK, &initial_mask, NULL);
+#endif
+
+    if (pipe2(self_pipe, O_NONBLOCK | O_CLOEXEC) == -1) {
+        perror("pipe2");
+        exit(1);
+    }
+    event_fd = self_pipe[0];
+    setup_handler(SIGCHLD, self_pipe_handler);
+    setup_handler(SIGINT, self_pipe_handler);
+    setup_handler(SIGTSTP, self_pipe_handler);
+}
+
+int signal_event_fd(void) {
+    return event_fd;
+}
+
+const sigset_t *child_signal_mask(void) {
+    return &initial_mask;
+}
+
+int handle_signal_events(void) {
+    int count = 0;
+    bool child = false, interrupt = false, stop = false;
+
+    // Drain everything that is pending first, so a burst of SIGCHLDs costs one reaping pass
+    for (;;) {
+        int signos[16];
+        int n = 0;
+#ifdef HAVE_SIGNALFD
+        if (event_fd != self_pipe[0]) {
+            struct signalfd_siginfo info[16];
+            ssize_t got = read(event_fd, info, sizeof(info));
+            for (ssize_t i = 0; got > 0 && i < got / (ssize_t)sizeof(info[0]); i++) {
+                signos[n++] = info[i].ssi_signo;
+            }
+        } else
+#endif
+        {
+            unsigned char bytes[16];
+            ssize_t got = read(event_fd, bytes, sizeof(bytes));
+            for (ssize_t i = 0; i < got; i++) {
+                signos[n++] = bytes[i];
+            }
+        }
+        if (n == 0) break;
+
+        for (int i = 0; i < n; i++) {
+            if (signos[i] == SIGCHLD) child = true;
+            else if (signos[i] == SIGINT) interrupt = true;
+            else if (signos[i] == SIGTSTP) stop = true;
+        }
+        count += n;
+    }
+
+    if (interrupt && !forward_to_foreground(SIGINT)) interrupted = true;
+    if (stop) forward_to_foreground(SIGTSTP);
+    if (child) reap_children();
+    return count;
+}
+
+bool take_interrupt(void) {
+    bool was = interrupted;
+    interrupted = false;
+    return was;
+}
+
+bool wait_signal_events(int timeout_ms) {
+    struct pollfd pfd = { .fd = event_fd, .events = POLLIN };
+    int ready = poll(&pfd, 1, timeout_ms);
+    if (ready == -1 && errno != EINTR) {
+        perror("poll");
+    }
+    return ready > 0 && handle_signal_events() > 0;
 }
@@ -0,0 +1,199 @@
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+bool trace_enabled = false;
+
+static bool initialized = false;
+static trace_event_t ring[TRACE_RING_SIZE]; // untouched pages cost nothing while tracing is off
+static uint64_t num_events = 0;             // Events ever recorded; the next goes to num_events % size
+
+// The phases stats reports, each measured between two kinds of events
+typedef enum phase { PHASE_PARSE, PHASE_RESOLVE, PHASE_LAUNCH, PHASE_RUN, PHASE_LINE, NUM_PHASES } phase_t;
+static const char *PHASE_NAMES[NUM_PHASES] = {"parse", "resolve", "launch", "run", "line"};
+
+typedef struct histogram {
+    uint64_t buckets[TRACE_BUCKETS]; // bucket i counts latencies in [2^i, 2^(i+1)) microseconds (0 also < 1us)
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t min_ns;
+    uint64_t max_ns;
+} histogram_t;
+
+// Launch time of a pid, for pairing launches with reaping
+typedef struct launch_time {
+    int32_t pid;            // 0 marks an empty entry
+    uint64_t ns;
+} launch_time_t;
+
+void trace_init(void) {
+    if (initialized) return;
+    initialized = true;
+    const char *value = getenv(TRACE_ENV);
+    trace_enabled = value && *value && strcmp(value, "0") != 0;
+}
+
+void trace_record(trace_type_t type, int arg) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    trace_event_t *event = &ring[num_events++ & (TRACE_RING_SIZE - 1)];
+    event->ns = (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+    event->type = type;
+    event->arg = arg;
+}
+
+static void add_latency(histogram_t *hist, uint64_t ns) {
+    uint64_t us = ns / 1000;
+    int bucket = us == 0 ? 0 : 63 - __builtin_clzll(us);
+    if (bucket >= TRACE_BUCKETS) bucket = TRACE_BUCKETS - 1;
+    hist->buckets[bucket]++;
+    if (hist->count == 0 || ns < hist->min_ns) hist->min_ns = ns;
+    if (ns > hist->max_ns) hist->max_ns = ns;
+    hist->count++;
+    hist->total_ns += ns;
+}
+
+// formats a duration with a unit that keeps it short
+static const char *format_ns(char *buf, size_t size, double ns) {
+    if (ns < 1e3) snprintf(buf, size, "%.0fns", ns);
+    else if (ns < 1e6) snprintf(buf, size, "%.1fus", ns / 1e3);
+    else if (ns < 1e9) snprintf(buf, size, "%.1fms", ns / 1e6);
+    else snprintf(buf, size, "%.2fs", ns / 1e9);
+    return buf;
+}
+
+// finds the entry of pid in a launch table of the given (power of two) size
+static launch_time_t *find_launch(launch_time_t *launches, size_t size, int32_t pid) {
+    size_t i = (uint32_t)pid * 2654435761u & (size - 1);
+    while (launches[i].pid != 0 && launches[i].pid != pid) {
+        i = (i + 1) & (size - 1);
+    }
+    return &launches[i];
+}
+
+// pairs up the events in the ring, oldest first, into per-phase latencies
+static bool build_histograms(histogram_t *hists) {
+    uint64_t kept = num_events < TRACE_RING_SIZE ? num_events : TRACE_RING_SIZE;
+    size_t size = 16;
+    while (size < 2 * kept) size *= 2; // room for every launch in the ring, at most half full
+    launch_time_t *launches = calloc(size, sizeof(launch_time_t));
+    if (!launches) {
+        perror("calloc");
+        return false;
+    }
+
+    uint64_t line_start = 0, last = 0, resolved = 0;
+    for (uint64_t i = num_events - kept; i < num_events; i++) {
+        const trace_event_t *event = &ring[i & (TRACE_RING_SIZE - 1)];
+        switch (event->type) {
+        case TRACE_LINE_READ:
+            line_start = last = event->ns;
+            break;
+        case TRACE_PARSED:
+            if (line_start) add_latency(&hists[PHASE_PARSE], event->ns - line_start);
+            last = event->ns;
+            break;
+        case TRACE_PATH_RESOLVED: // measured from the previous step of the line
+            if (last) add_latency(&hists[PHASE_RESOLVE], event->ns - last);
+            last = resolved = event->ns;
+            break;
+        case TRACE_LAUNCHED: {
+            if (resolved) add_latency(&hists[PHASE_LAUNCH], event->ns - resolved);
+            resolved = 0; // a forked builtin has no PATH lookup
+            last = event->ns;
+            launch_time_t *entry = find_launch(launches, size, event->arg);
+            entry->pid = event->arg;
+            entry->ns = event->ns;
+            break;
+        }
+        case TRACE_REAPED: {
+            launch_time_t *entry = find_launch(launches, size, event->arg);
+            if (entry->pid != 0) add_latency(&hists[PHASE_RUN], event->ns - entry->ns);
+            break;
+        }
+        case TRACE_PROMPT:
+            if (line_start) add_latency(&hists[PHASE_LINE], event->ns - line_start);
+            line_start = last = resolved = 0;
+            break;
+        }
+    }
+    free(launches);
+    return true;
+}
+
+static void print_histograms(const histogram_t *hists) {
+    char min[16], avg[16], max[16], low[16], high[16];
+    printf("%-8s %8s %9s %9s %9s\n", "phase", "count", "min", "avg", "max");
+    for (int p = 0; p < NUM_PHASES; p++) {
+        const histogram_t *hist = &hists[p];
+        printf("%-8s %8lu %9s %9s %9s\n", PHASE_NAMES[p], (unsigned long)hist->count,
+               format_ns(min, sizeof(min), hist->min_ns),
+               format_ns(avg, sizeof(avg), hist->count ? (double)hist->total_ns / hist->count : 0),
+               format_ns(max, sizeof(max), hist->max_ns));
+    }
+
+    for (int p = 0; p < NUM_PHASES; p++) {
+        const histogram_t *hist = &hists[p];
+        if (hist->count == 0) continue;
+        uint64_t peak = 0;
+        for (int b = 0; b < TRACE_BUCKETS; b++) {
+            if (hist->buckets[b] > peak) peak = hist->buckets[b];
+        }
+        printf("\n%s:\n", PHASE_NAMES[p]);
+        for (int b = 0; b < TRACE_BUCKETS; b++) {
+            if (hist->buckets[b] == 0) continue;
+            int width = (int)(40 * hist->buckets[b] / peak);
+            printf("  %8s - %-8s |%-40.*s| %lu\n",
+                   format_ns(low, sizeof(low), b == 0 ? 0 : 1000.0 * (1ULL << b)),
+                   format_ns(high, sizeof(high), 1000.0 * (2ULL << b)),
+                   width > 0 ? width : 1, "########################################",
+                   (unsigned long)hist->buckets[b]);
+        }
+    }
+}
+
+// writes the ring, oldest event first, to a dump file
+static void dump_ring(const char *path) {
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        perror(path);
+        return;
+    }
+    uint64_t kept = num_events < TRACE_RING_SIZE ? num_events : TRACE_RING_SIZE;
+    trace_dump_header_t header = {.version = TRACE_DUMP_VERSION, .count = (uint32_t)kept};
+    memcpy(header.magic, TRACE_DUMP_MAGIC, sizeof(header.magic));
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (uint64_t i = num_events - kept; ok && i < num_events; i++) {
+        ok = fwrite(&ring[i & (TRACE_RING_SIZE - 1)], sizeof(trace_event_t), 1, file) == 1;
+    }
+    if (fclose(file) != 0 || !ok) {
+        perror(path);
+    }
+}
+
+// Command: stats [-r] [-d FILE]
+char *builtin_stats(int argc, char **argv) {
+    if (!trace_enabled) {
+        fprintf(stderr, "stats: tracing is off; start msh with %s=1\n", TRACE_ENV);
+        return NULL;
+    }
+    if (argc > 1 && strcmp(argv[1], "-r") == 0) {
+        num_events = 0;
+        return NULL;
+    }
+    if (argc > 1 && strcmp(argv[1], "-d") == 0) {
+        if (argc < 3) {
+            fprintf(stderr, "usage: stats [-r] [-d FILE]\n");
+        } else {
+            dump_ring(argv[2]);
+        }
+        return NULL;
+    }
+
+    histogram_t hists[NUM_PHASES];
+    memset(hists, 0, sizeof(hists));
+    if (build_histograms(hists)) print_histograms(hists);
+    return NULL;
+}
@@ -0,0 +1,487 @@
+#include "utilities.h"
+#include "builtins.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>     // For PATH_MAX
+#include <unistd.h>     // For access, getcwd, isatty
+#include <sys/stat.h>
+
+// decodes the escape sequence after a backslash into *c; returns the number of characters used, 0 for \c
+// (stop all output) or -1 if s does not start an escape sequence. echo takes octal as \0NNN, printf as \NNN.
+static int decode_escape(const char *s, char *c, bool echo_octal) {
+    static const char plain[] = "a\ab\be\033f\fn\nr\rt\tv\v\\\\";
+    for (int i = 0; plain[i]; i += 2) {
+        if (*s == plain[i]) {
+            *c = plain[i + 1];
+            return 1;
+        }
+    }
+    int used = 0, value = 0;
+    if (*s == 'c') {
+        return 0;
+    } else if (*s == 'x') {
+        for (used = 1; used < 3 && isxdigit((unsigned char)s[used]); used++) {
+            value = value * 16 + (isdigit((unsigned char)s[used]) ? s[used] - '0' : tolower(s[used]) - 'a' + 10);
+        }
+        if (used == 1) return -1; // \x without digits
+    } else if (*s >= '0' && *s <= '7') {
+        int start = (echo_octal && *s == '0') ? 1 : 0; // echo's \0 does not count as a digit
+        for (used = start; used < start + 3 && s[used] >= '0' && s[used] <= '7'; used++) {
+            value = value * 8 + s[used] - '0';
+        }
+        if (used == 0) used = 1;
+    } else {
+        return -1;
+    }
+    *c = (char)value;
+    return used;
+}
+
+// prints s with its escape sequences decoded; returns false if a \c stopped the output
+static bool put_escaped(const char *s, bool echo_octal) {
+    while (*s) {
+        char c;
+        int used;
+        if (*s == '\\' && (used = decode_escape(s + 1, &c, echo_octal)) != -1) {
+            if (used == 0) return false;
+            putchar(c);
+            s += used + 1;
+        } else {
+            putchar(*s++);
+        }
+    }
+    return true;
+}
+
+char *utility_true(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    builtin_status = 0;
+    return NULL;
+}
+
+char *utility_false(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+    builtin_status = 1;
+    return NULL;
+}
+
+// Command: echo [-neE] [STRING...]
+char *utility_echo(int argc, char **argv) {
+    bool newline = true, escapes = false;
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-' && argv[i][1]; i++) {
+        const char *flags = &argv[i][1];
+        if (flags[strspn(flags, "neE")] != '\0') break; // not an option, so it is echoed
+        for (; *flags; flags++) {
+            if (*flags == 'n') newline = false;
+            else escapes = *flags == 'e';
+        }
+    }
+
+    builtin_status = 0;
+    for (; i < argc; i++) {
+        if (!escapes) {
+            fputs(argv[i], stdout);
+        } else if (!put_escaped(argv[i], true)) {
+            return NULL; // \c: no further output, not even the newline
+        }
+        if (i < argc - 1) putchar(' ');
+    }
+    if (newline) putchar('\n');
+    return NULL;
+}
+
+// Command: pwd [-LP]
+char *utility_pwd(int argc, char **argv) {
+    bool logical = false;
+    for (int i = 1; i < argc && argv[i][0] == '-'; i++) {
+        for (const char *flag = &argv[i][1]; *flag; flag++) {
+            if (*flag != 'L' && *flag != 'P') {
+                fprintf(stderr, "pwd: invalid option -- '%c'\n", *flag);
+                builtin_status = 1;
+                return NULL;
+            }
+            logical = *flag == 'L';
+        }
+    }
+
+    builtin_status = 0;
+    const char *pwd = getenv("PWD");
+    struct stat env_st, dot_st;
+    if (logical && pwd && pwd[0] == '/' && !strstr(pwd, "/./") && !strstr(pwd, "/../") &&
+        stat(pwd, &env_st) == 0 && stat(".", &dot_st) == 0 &&
+        env_st.st_dev == dot_st.st_dev && env_st.st_ino == dot_st.st_ino) {
+        puts(pwd); // $PWD names the current directory, symbolic links and all
+        return NULL;
+    }
+    char cwd[PATH_MAX];
+    if (getcwd(cwd, sizeof(cwd))) {
+        puts(cwd);
+    } else {
+        perror("pwd");
+        builtin_status = 1;
+    }
+    return NULL;
+}
+
+// The state of one test or [ evaluation
+typedef struct test_expr {
+    char **argv;    // The operands and operators
+    int end;        // The number of them
+    int pos;        // The next one to read
+    bool error;     // Set on a syntax error or invalid integer (exit status 2)
+} test_expr_t;
+
+static bool is_unary_op(const char *s) {
+    return s[0] == '-' && s[1] && strchr("bcdefghkLnprsStuwxzGO", s[1]) && s[2] == '\0';
+}
+
+static bool is_binary_op(const char *s) {
+    static const char *ops[] = {"=", "==", "!=", "<", ">", "-eq", "-ne", "-lt", "-le", "-gt", "-ge",
+                                "-nt", "-ot", "-ef", NULL};
+    for (int i = 0; ops[i]; i++) {
+        if (strcmp(s, ops[i]) == 0) return true;
+    }
+    return false;
+}
+
+static bool test_integer(test_expr_t *expr, const char *s, long long *value) {
+    char *end;
+    errno = 0;
+    *value = strtoll(s, &end, 10);
+    while (isspace((unsigned char)*end)) end++;
+    if (end == s || *end || errno == ERANGE) {
+        fprintf(stderr, "test: invalid integer '%s'\n", s);
+        expr->error = true;
+        return false;
+    }
+    return true;
+}
+
+static bool unary_test(test_expr_t *expr, char op, const char *arg) {
+    struct stat st;
+    if (op == 'n') return arg[0] != '\0';
+    if (op == 'z') return arg[0] == '\0';
+    if (op == 't') {
+        long long fd;
+        return test_integer(expr, arg, &fd) && fd >= 0 && fd <= INT_MAX && isatty((int)fd);
+    }
+    if (op == 'h' || op == 'L') return lstat(arg, &st) == 0 && S_ISLNK(st.st_mode);
+    if (op == 'r') return access(arg, R_OK) == 0;
+    if (op == 'w') return access(arg, W_OK) == 0;
+    if (op == 'x') return access(arg, X_OK) == 0;
+    if (stat(arg, &st) != 0) return false;
+    switch (op) {
+    case 'b': return S_ISBLK(st.st_mode);
+    case 'c': return S_ISCHR(st.st_mode);
+    case 'd': return S_ISDIR(st.st_mode);
+    case 'f': return S_ISREG(st.st_mode);
+    case 'p': return S_ISFIFO(st.st_mode);
+    case 'S': return S_ISSOCK(st.st_mode);
+    case 's': return st.st_size > 0;
+    case 'g': return (st.st_mode & S_ISGID) != 0;
+    case 'u': return (st.st_mode & S_ISUID) != 0;
+    case 'k': return (st.st_mode & S_ISVTX) != 0;
+    case 'O': return st.st_uid == geteuid();
+    case 'G': return st.st_gid == getegid();
+    default: return true; // -e
+    }
+}
+
+static bool binary_test(test_expr_t *expr, const char *left, const char *op, const char *right) {
+    if (strcmp(op, "=") == 0 || strcmp(op, "==") == 0) return strcmp(left, right) == 0;
+    if (strcmp(op, "!=") == 0) return strcmp(left, right) != 0;
+    if (strcmp(op, "<") == 0) return strcoll(left, right) < 0;
+    if (strcmp(op, ">") == 0) return strcoll(left, right) > 0;
+    if (strcmp(op, "-a") == 0) return left[0] && right[0];
+    if (strcmp(op, "-o") == 0) return left[0] || right[0];
+
+    if (strcmp(op, "-nt") == 0 || strcmp(op, "-ot") == 0 || strcmp(op, "-ef") == 0) {
+        struct stat l, r;
+        bool have_l = stat(left, &l) == 0, have_r = stat(right, &r) == 0;
+        if (op[1] == 'e') return have_l && have_r && l.st_dev == r.st_dev && l.st_ino == r.st_ino;
+        if (op[1] == 'o') { // -ot is -nt with the files swapped
+            struct stat swap = l;
+            bool have_swap = have_l;
+            l = r, have_l = have_r;
+            r = swap, have_r = have_swap;
+        }
+        if (!have_l) return false;
+        if (!have_r) return true; // an existing file is newer than a missing one
+        return l.st_mtim.tv_sec > r.st_mtim.tv_sec ||
+               (l.st_mtim.tv_sec == r.st_mtim.tv_sec && l.st_mtim.tv_nsec > r.st_mtim.tv_nsec);
+    }
+
+    long long a, b;
+    if (!test_integer(expr, left, &a) || !test_integer(expr, right, &b)) return false;
+    if (strcmp(op, "-eq") == 0) return a == b;
+    if (strcmp(op, "-ne") == 0) return a != b;
+    if (strcmp(op, "-lt") == 0) return a < b;
+    if (strcmp(op, "-le") == 0) return a <= b;
+    if (strcmp(op, "-gt") == 0) return a > b;
+    return a >= b; // -ge
+}
+
+static bool test_or(test_expr_t *expr);
+
+// primary: ( EXPR ) | UNARY-OP ARG | ARG BINARY-OP ARG | ARG
+static bool test_primary(test_expr_t *expr) {
+    char **argv = expr->argv;
+    int left = expr->end - expr->pos;
+    if (left <= 0) {
+        fprintf(stderr, "test: argument expected\n");
+        expr->error = true;
+        return false;
+    }
+    char *arg = argv[expr->pos];
+    if (left >= 3 && is_binary_op(argv[expr->pos + 1])) {
+        expr->pos += 3;
+        return binary_test(expr, arg, argv[expr->pos - 2], argv[expr->pos - 1]);
+    }
+    if (left >= 2 && is_unary_op(arg)) {
+        expr->pos += 2;
+        return unary_test(expr, arg[1], argv[expr->pos - 1]);
+    }
+    if (left >= 2 && strcmp(arg, "(") == 0) {
+        expr->pos++;
+        bool value = test_or(expr);
+        if (expr->pos >= expr->end || strcmp(argv[expr->pos], ")") != 0) {
+            fprintf(stderr, "test: ')' expected\n");
+            expr->error = true;
+            return false;
+        }
+        expr->pos++;
+        return value;
+    }
+    expr->pos++;
+    return arg[0] != '\0';
+}
+
+static bool test_not(test_expr_t *expr) {
+    if (expr->end - expr->pos > 1 && strcmp(expr->argv[expr->pos], "!") == 0) {
+        expr->pos++;
+        return !test_not(expr);
+    }
+    return test_primary(expr);
+}
+
+static bool test_and(test_expr_t *expr) {
+    bool value = test_not(expr);
+    while (expr->pos < expr->end && strcmp(expr->argv[expr->pos], "-a") == 0) {
+        expr->pos++;
+        value = test_not(expr) && value;
+    }
+    return value;
+}
+
+static bool test_or(test_expr_t *expr) {
+    bool value = test_and(expr);
+    while (expr->pos < expr->end && strcmp(expr->argv[expr->pos], "-o") == 0) {
+        expr->pos++;
+        value = test_and(expr) || value;
+    }
+    return value;
+}
+
+// evaluates argv[0..n) by the POSIX rules for up to four arguments, and by precedence beyond that
+static bool test_args(test_expr_t *expr, char **argv, int n) {
+    if (n == 0) return false;
+    if (n == 1) return argv[0][0] != '\0';
+    if (n == 2) {
+        if (strcmp(argv[0], "!") == 0) return argv[1][0] == '\0';
+        if (is_unary_op(argv[0])) return unary_test(expr, argv[0][1], argv[1]);
+        fprintf(stderr, "test: '%s': unary operator expected\n", argv[0]);
+        expr->error = true;
+        return false;
+    }
+    if (n == 3) {
+        if (is_binary_op(argv[1]) || strcmp(argv[1], "-a") == 0 || strcmp(argv[1], "-o") == 0) {
+            return binary_test(expr, argv[0], argv[1], argv[2]);
+        }
+        if (strcmp(argv[0], "!") == 0) return !test_args(expr, argv + 1, 2);
+        if (strcmp(argv[0], "(") == 0 && strcmp(argv[2], ")") == 0) return argv[1][0] != '\0';
+    }
+    if (n == 4) {
+        if (strcmp(argv[0], "!") == 0) return !test_args(expr, argv + 1, 3);
+        if (strcmp(argv[0], "(") == 0 && strcmp(argv[3], ")") == 0) return test_args(expr, argv + 1, 2);
+    }
+
+    expr->argv = argv;
+    expr->end = n;
+    expr->pos = 0;
+    bool value = test_or(expr);
+    if (!expr->error && expr->pos < n) {
+        fprintf(stderr, "test: extra argument '%s'\n", argv[expr->pos]);
+        expr->error = true;
+    }
+    return value;
+}
+
+// Commands: test EXPRESSION or [ EXPRESSION ]
+char *utility_test(int argc, char **argv) {
+    if (strcmp(argv[0], "[") == 0) {
+        if (strcmp(argv[argc - 1], "]") != 0) {
+            fprintf(stderr, "[: missing ']'\n");
+            builtin_status = 2;
+            return NULL;
+        }
+        argc--; // the ] is not part of the expression
+    }
+    test_expr_t expr = {.error = false};
+    bool value = test_args(&expr, argv + 1, argc - 1);
+    builtin_status = expr.error ? 2 : !value;
+    return NULL;
+}
+
+// reads a numeric printf argument: an integer in C notation, or 'c for the code of the character c
+static long long integer_arg(const char *arg, bool is_unsigned) {
+    if (arg[0] == '\'' || arg[0] == '"') return (unsigned char)arg[1];
+    char *end;
+    errno = 0;
+    long long value = is_unsigned && arg[0] != '-' ? (long long)strtoull(arg, &end, 0) : strtoll(arg, &end, 0);
+    if (end == arg) {
+        fprintf(stderr, "printf: '%s': expected a numeric value\n", arg);
+        builtin_status = 1;
+    } else if (*end || errno == ERANGE) {
+        fprintf(stderr, "printf: '%s': value not completely converted\n", arg);
+        builtin_status = 1;
+    }
+    return value;
+}
+
+static long double float_arg(const char *arg) {
+    if (arg[0] == '\'' || arg[0] == '"') return (unsigned char)arg[1];
+    char *end;
+    long double value = strtold(arg, &end);
+    if (end == arg) {
+        fprintf(stderr, "printf: '%s': expected a numeric value\n", arg);
+        builtin_status = 1;
+    } else if (*end) {
+        fprintf(stderr, "printf: '%s': value not completely converted\n", arg);
+        builtin_status = 1;
+    }
+    return value;
+}
+
+// prints the format once, taking arguments from args[*used..]; returns false to stop (\c or a bad format)
+static bool print_format(const char *format, char **args, int nargs, int *used) {
+    for (const char *f = format; *f; f++) {
+        if (*f == '\\') {
+            char c;
+            int n = decode_escape(f + 1, &c, false);
+            if (n == 0) return false;
+            if (n == -1) {
+                putchar('\\');
+            } else {
+                putchar(c);
+                f += n;
+            }
+            continue;
+        }
+        if (*f != '%') {
+            putchar(*f);
+            continue;
+        }
+        if (f[1] == '%') {
+            putchar('%');
+            f++;
+            continue;
+        }
+
+        // Rebuild the conversion with its flags, width and precision, replacing each * with its argument
+        char spec[64] = "%";
+        size_t len = 1;
+        const char *start = f++;
+        for (; *f && strchr("-+ #0", *f) && len < 16; f++) spec[len++] = *f;
+        for (int part = 0; part < 2; part++) {
+            if (part == 1) {
+                if (*f != '.') break;
+                spec[len++] = *f++;
+            }
+            if (*f == '*') {
+                const char *arg = *used < nargs ? args[(*used)++] : "0";
+                len += snprintf(spec + len, sizeof(spec) - len, "%d", (int)integer_arg(arg, false));
+                f++;
+            } else {
+                for (; isdigit((unsigned char)*f) && len < 40; f++) spec[len++] = *f;
+            }
+        }
+        while (*f && strchr("hljztL", *f)) f++; // the size is chosen from the conversion alone
+
+        const char *arg = *used < nargs ? args[(*used)++] : NULL;
+        switch (*f) {
+        case 'd': case 'i':
+            strcpy(spec + len, "lld");
+            printf(spec, arg ? integer_arg(arg, false) : 0LL);
+            break;
+        case 'o': case 'u': case 'x': case 'X':
+            snprintf(spec + len, sizeof(spec) - len, "ll%c", *f);
+            printf(spec, arg ? (unsigned long long)integer_arg(arg, true) : 0ULL);
+            break;
+        case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+            snprintf(spec + len, sizeof(spec) - len, "L%c", *f);
+            printf(spec, arg ? float_arg(arg) : 0.0L);
+            break;
+        case 'c':
+            if (!arg || !arg[0]) { // no character: only the padding, never a NUL byte
+                strcpy(spec + len, "s");
+                printf(spec, "");
+                break;
+            }
+            strcpy(spec + len, "c");
+            printf(spec, arg[0]);
+            break;
+        case 's':
+            strcpy(spec + len, "s");
+            printf(spec, arg ? arg : "");
+            break;
+        case 'b': { // the argument's escapes are decoded, as by echo -e
+            if (!arg) arg = "";
+            char text[strlen(arg) + 1];
+            size_t n = 0;
+            bool stop = false;
+            for (const char *s = arg; *s && !stop; s++) {
+                int esc;
+                if (*s == '\\' && (esc = decode_escape(s + 1, &text[n], true)) != -1) {
+                    if (esc == 0) stop = true;
+                    else n++, s += esc;
+                } else {
+                    text[n++] = *s;
+                }
+            }
+            text[n] = '\0';
+            strcpy(spec + len, "s");
+            printf(spec, text);
+            if (stop) return false;
+            break;
+        }
+        default:
+            fprintf(stderr, "printf: %.*s: invalid conversion specification\n", (int)(f - start + (*f != '\0')), start);
+            builtin_status = 1;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Command: printf FORMAT [ARGUMENT...]
+char *utility_printf(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "printf: missing operand\n");
+        builtin_status = 1;
+        return NULL;
+    }
+    builtin_status = 0;
+    int used = 0, before;
+    do { // the format is reused while it consumes arguments
+        before = used;
+        if (!print_format(argv[1], argv + 2, argc - 2, &used)) break;
+    } while (used < argc - 2 && used > before);
+    return NULL;
+}
@@ -0,0 +1,41 @@
+#! /usr/bin/env bash
+
+# Builds an allocation-counting msh (see src/alloc_count.c) from the sources
+# in SRC and reports heap allocations per command for a few kinds of command
+# lines. Each workload runs with N and 2N lines; the difference cancels the
+# allocations made at startup and exit. Point SRC at an older checkout to
+# compare. Usage: ./bench_alloc.sh [N] [SRC]
+
+N=${1:-2000}
+SRC=${2:-..}
+
+WORK=$(mktemp -d)
+BIN=$WORK/msh
+EXTRA=$([[ -e $SRC/src/alloc_count.c ]] || echo $PWD/../src/alloc_count.c) # older trees lack it
+gcc -O2 -DMSH_ALLOC_COUNT -I$SRC/include -o $BIN $SRC/src/*.c $EXTRA \
+    -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=strdup,--wrap=strndup || exit 1
+
+# Run where ../data does not exist, so the history stays in memory and data/.msh_history is untouched
+mkdir $WORK/run
+cd $WORK/run
+
+# allocations LINE COUNT: total allocations for COUNT copies of LINE
+allocations() {
+     for ((i = 0; i < $2; i++)); do echo "$1"; done | $BIN -s 100 2>&1 > /dev/null |
+          awk -F= '/alloc_count/ { print $2 }'
+}
+
+report() {
+     local one=$(allocations "$2" $N) two=$(allocations "$2" $((N * 2)))
+     awk -v name=$1 -v n=$N -v a=$one -v b=$two 'BEGIN {
+          printf "bench=alloc workload=%s commands=%d allocs_per_command=%.2f\n", name, n, (b - a) / n
+     }'
+}
+
+report builtin "jobs"
+report history_search "history -s jobs"
+report foreground "/usr/bin/true"
+report pipeline "/usr/bin/true | /usr/bin/true"
+report quoted "/usr/bin/true 'one arg' \"two args\" three"
+
+rm -rf $WORK
@@ -0,0 +1,49 @@
+#! /usr/bin/env bash
+
+# Compares batch mode without prompts (-b: mmap'd or block-read script,
+# buffered output) with the interactive read loop forced by -i. Runs the milestone2
+# inputs and a generated script of N lines, and reports wall time and, when
+# strace is installed, the number of system calls made by the shell itself.
+# Usage: ./bench_batch.sh [N] [MSH]
+
+N=${1:-100000}
+MSH=${2:-../bin/msh}
+
+SCRIPT=$(mktemp)
+for ((i = 0; i < N; i++)); do
+     if ((i % 1000 == 0)); then
+          echo "/usr/bin/true"
+     else
+          echo "jobs"
+     fi
+done > $SCRIPT
+
+# run_mode NAME MODE_FLAGS ARGS INPUT
+run_mode() {
+     local start end syscalls="n/a"
+     start=$(date +%s%N)
+     $MSH $2 $3 < $4 > /dev/null 2>&1
+     end=$(date +%s%N)
+     if command -v strace > /dev/null; then
+          syscalls=$(strace -c -o /dev/stdout $MSH $2 $3 < $4 2> /dev/null | awk '/total/ { print $3 }')
+     fi
+     echo "$(( (end - start) / 1000 )) $syscalls"
+}
+
+report() {
+     local name=$1 args=$2 input=$3
+     read -r batch_us batch_calls <<< "$(run_mode $name -b "$args" $input)"
+     read -r inter_us inter_calls <<< "$(run_mode $name -i "$args" $input)"
+     printf "bench=batch input=%s batch_us=%d interactive_us=%d batch_syscalls=%s interactive_syscalls=%s\n" \
+            $name $batch_us $inter_us $batch_calls $inter_calls
+}
+
+report script_${N} "" $SCRIPT
+
+cd milestone2
+for file in test0{01,04,05,06,07,08,09,10,11,12,13,14,15,16,19}.in; do
+     report ${file%.in} "$(cat ${file%.in}.args)" $file
+done
+cd ..
+
+rm -f $SCRIPT
@@ -0,0 +1,61 @@
+#include "history.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+// Measures add_line_history and find_line_history throughput for histories of 10^3, 10^5 and 10^6
+// lines. Each history is filled and then wrapped around once more, so half of the adds evict the oldest
+// line. The history file is redirected to a scratch path so ../data/.msh_history is left alone.
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench(int size) {
+    char line[64];
+    history_t *history = alloc_history(size);
+    if (!history) exit(1);
+
+    int adds = size * 2;
+    double start = now_sec();
+    for (int i = 0; i < adds; i++) {
+        snprintf(line, sizeof(line), "/usr/bin/echo command %d", i);
+        add_line_history(history, line);
+    }
+    double add_time = now_sec() - start;
+
+    int lookups = 1000000;
+    unsigned long found = 0;
+    start = now_sec();
+    for (int i = 0; i < lookups; i++) {
+        found += find_line_history(history, 1 + (int)((i * 2654435761u) % size)) != NULL;
+    }
+    double find_time = now_sec() - start;
+
+    printf("bench=history_add size=%d adds=%d adds_per_sec=%.0f ns_per_add=%.1f\n",
+           size, adds, adds / add_time, add_time * 1e9 / adds);
+    printf("bench=history_find size=%d lookups=%d found=%lu ns_per_lookup=%.1f\n",
+           size, lookups, found, find_time * 1e9 / lookups);
+
+    free_history(history);
+    remove(HISTORY_FILE_PATH);
+}
+
+int main() {
+    char path[] = "/tmp/msh_bench_historyXXXXXX";
+    int fd = mkstemp(path);
+    if (fd == -1) {
+        perror("mkstemp");
+        return 1;
+    }
+    close(fd);
+    HISTORY_FILE_PATH = path;
+
+    bench(1000);
+    bench(100000);
+    bench(1000000);
+    return 0;
+}
@@ -0,0 +1,90 @@
+#include "history.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Measures search_history latency against history size (10^3 to 10^6 lines) and compares it with a
+// linear strstr scan over the same lines. The history file is redirected to a scratch path so
+// ../data/.msh_history is left alone.
+
+static const char *COMMANDS[] = {"ls -la", "cd", "cat", "grep -r", "make -j8", "git status", "vim",
+                                 "ssh", "sleep", "echo", "/usr/bin/bc -q", "tar xzf", "cp", "rm -f"};
+static const int NUM_COMMANDS = sizeof(COMMANDS) / sizeof(COMMANDS[0]);
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// newest line containing text, found by scanning every line
+static int linear_search(history_t *history, const char *text) {
+    for (int i = history->count; i >= 1; i--) {
+        if (strstr(find_line_history(history, i), text)) return i;
+    }
+    return 0;
+}
+
+static void bench_query(history_t *history, int size, const char *kind, const char *text, bool prefix) {
+    int match;
+    int reps = 200;
+    double start = now_sec();
+    for (int r = 0; r < reps; r++) {
+        search_history(history, text, prefix, &match, 1);
+    }
+    double indexed = (now_sec() - start) / reps;
+
+    start = now_sec();
+    for (int r = 0; r < 5; r++) {
+        linear_search(history, text);
+    }
+    double linear = (now_sec() - start) / 5;
+
+    printf("bench=history_search size=%d query=%s indexed_us=%.2f linear_us=%.2f\n",
+           size, kind, indexed * 1e6, linear * 1e6);
+}
+
+static void bench(int size) {
+    char line[128];
+    history_t *history = alloc_history(size);
+    if (!history) exit(1);
+
+    srand(42);
+    for (int i = 0; i < size; i++) {
+        snprintf(line, sizeof(line), "%s file%d.txt dir%d", COMMANDS[rand() % NUM_COMMANDS],
+                 rand() % 100000, rand() % 1000);
+        add_line_history(history, line);
+    }
+    add_line_history(history, "needle-in-the-haystack --once"); // a single rare line...
+    for (int i = 0; i < size / 2; i++) {                         // ...buried under newer ones
+        snprintf(line, sizeof(line), "%s file%d.txt", COMMANDS[rand() % NUM_COMMANDS], rand() % 100000);
+        add_line_history(history, line);
+    }
+
+    bench_query(history, size, "rare_substring", "haystack", false);
+    bench_query(history, size, "rare_prefix", "needle", true);
+    bench_query(history, size, "common_substring", "file1234", false);
+    bench_query(history, size, "missing", "no-such-command", false);
+
+    free_history(history);
+    remove(HISTORY_FILE_PATH);
+}
+
+int main() {
+    char path[] = "/tmp/msh_bench_searchXXXXXX";
+    int fd = mkstemp(path);
+    if (fd == -1) {
+        perror("mkstemp");
+        return 1;
+    }
+    close(fd);
+    HISTORY_FILE_PATH = path;
+
+    bench(1000);
+    bench(10000);
+    bench(100000);
+    bench(1000000);
+    return 0;
+}
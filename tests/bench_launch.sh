@@ -0,0 +1,30 @@
+#! /usr/bin/env bash
+
+# Compares job launch rates of the fork, posix_spawn and zygote backends (MSH_LAUNCH).
+# For each backend it runs N foreground `/usr/bin/true` commands and N
+# background `/usr/bin/true &` commands through msh and reports jobs/sec.
+# Usage: ./bench_launch.sh [N] [MSH]
+
+N=${1:-1000}
+MSH=${2:-../bin/msh}
+
+FG_SCRIPT=$(mktemp)
+BG_SCRIPT=$(mktemp)
+for ((i = 0; i < N; i++)); do
+     echo "/usr/bin/true"
+     echo "/usr/bin/true &" >> $BG_SCRIPT
+done > $FG_SCRIPT
+
+for backend in fork spawn zygote; do
+     for mode in fg bg; do
+          if [[ $mode == fg ]]; then SCRIPT=$FG_SCRIPT; else SCRIPT=$BG_SCRIPT; fi
+          START=$(date +%s%N)
+          MSH_LAUNCH=$backend $MSH -j $((N + 1)) < $SCRIPT > /dev/null
+          END=$(date +%s%N)
+          awk -v b=$backend -v m=$mode -v n=$N -v ns=$((END - START)) 'BEGIN {
+               printf "bench=launch backend=%s mode=%s jobs=%d total_ms=%.1f jobs_per_sec=%.0f\n",
+                      b, m, n, ns / 1e6, n / (ns / 1e9)
+          }'
+     done
+done
+rm -f $FG_SCRIPT $BG_SCRIPT
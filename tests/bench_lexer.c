@@ -0,0 +1,75 @@
+#include "lexer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Measures lex_line throughput in MB/s of command text, for short typical lines, quoted lines, long
+// pipelines and a line too long for the lexer's inline storage. A strtok split of the same text (what
+// separate_args used to do, without quotes or operators) is reported as a baseline.
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// splits on blanks only, with strtok, into a heap argv grown from 10 slots
+static int strtok_split(char *line) {
+    int capacity = 10, argc = 0;
+    char **argv = malloc(capacity * sizeof(char *));
+    for (char *token = strtok(line, " \t"); token; token = strtok(NULL, " \t")) {
+        if (argc + 1 >= capacity) {
+            capacity *= 2;
+            argv = realloc(argv, capacity * sizeof(char *));
+        }
+        argv[argc++] = token;
+    }
+    argv[argc] = NULL;
+    free(argv);
+    return argc;
+}
+
+static void bench(const char *kind, const char *line) {
+    size_t len = strlen(line);
+    int reps = (int)(200000000 / (len + 1)); // about 200 MB of text per measurement
+    if (reps < 100) reps = 100;
+    char *copy = malloc(len + 1);
+    lexer_t lex;
+    long tokens = 0;
+
+    double start = now_sec();
+    for (int r = 0; r < reps; r++) {
+        tokens += lex_line(&lex, line, NULL);
+        lex_free(&lex);
+    }
+    double lex_time = now_sec() - start;
+
+    long words = 0;
+    start = now_sec();
+    for (int r = 0; r < reps; r++) {
+        memcpy(copy, line, len + 1); // strtok writes into the line
+        words += strtok_split(copy);
+    }
+    double strtok_time = now_sec() - start;
+
+    double mb = (double)len * reps / 1e6;
+    printf("bench=lexer line=%s bytes=%zu tokens=%ld lex_mb_per_sec=%.1f strtok_mb_per_sec=%.1f\n",
+           kind, len, tokens / reps, mb / lex_time, mb / strtok_time);
+    free(copy);
+}
+
+int main() {
+    bench("simple", "ls -la /usr/local/bin");
+    bench("pipeline", "cat access.log | grep -v healthcheck | sort -k2 | uniq -c > counts.txt &");
+    bench("quoted", "grep -e \"error: \\\"disk full\\\"\" 'logs/app 1.log' --color=never; echo done\\;");
+
+    char *huge = malloc(64 * 1024);
+    huge[0] = '\0';
+    while (strlen(huge) + 32 < 64 * 1024) {
+        strcat(huge, "/usr/bin/echo argument-text ");
+    }
+    bench("long_64k", huge);
+    free(huge);
+    return 0;
+}
@@ -0,0 +1,80 @@
+#include "shell.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Measures parse_tok and separate_args throughput on generated command lines: lines of several jobs
+// for parse_tok, single commands with a growing number of arguments for separate_args. Reports lines
+// per second and MB/s of command text.
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// fills line with a command of nargs arguments
+static void make_command(char *line, size_t size, int nargs, int seed) {
+    int len = snprintf(line, size, "/usr/bin/cmd%d", seed % 97);
+    for (int a = 0; a < nargs && len < (int)size - 32; a++) {
+        len += snprintf(line + len, size - len, " --arg%d=value%d", a, (seed + a) % 1013);
+    }
+}
+
+static void bench_parse_tok(int njobs) {
+    char line[4096], copy[4096];
+    line[0] = '\0';
+    for (int j = 0; j < njobs; j++) { // alternate ; and & separated jobs
+        char command[256];
+        make_command(command, sizeof(command), 3, j);
+        strcat(line, command);
+        strcat(line, j % 2 ? " & " : " ; ");
+    }
+    size_t len = strlen(line);
+    int reps = (int)(100000000 / (len + 1)); // about 100 MB of text
+    long jobs = 0;
+
+    double start = now_sec();
+    for (int r = 0; r < reps; r++) {
+        memcpy(copy, line, len + 1); // parse_tok writes into the line
+        int job_type;
+        for (char *job = parse_tok(copy, &job_type); job; job = parse_tok(NULL, &job_type)) {
+            jobs++;
+        }
+    }
+    double elapsed = now_sec() - start;
+    printf("bench=parse_tok jobs_per_line=%d bytes=%zu lines_per_sec=%.0f mb_per_sec=%.1f\n",
+           (int)(jobs / reps), len, reps / elapsed, len * reps / elapsed / 1e6);
+}
+
+static void bench_separate_args(int nargs) {
+    char line[4096], copy[4096];
+    make_command(line, sizeof(line), nargs, 7);
+    size_t len = strlen(line);
+    int reps = (int)(100000000 / (len + 1));
+    long args = 0;
+
+    double start = now_sec();
+    for (int r = 0; r < reps; r++) {
+        memcpy(copy, line, len + 1); // separate_args writes into the line
+        int argc;
+        bool is_builtin;
+        char **argv = separate_args(copy, &argc, &is_builtin);
+        args += argc;
+        free(argv);
+    }
+    double elapsed = now_sec() - start;
+    printf("bench=separate_args args=%d bytes=%zu lines_per_sec=%.0f mb_per_sec=%.1f\n",
+           (int)(args / reps), len, reps / elapsed, len * reps / elapsed / 1e6);
+}
+
+int main() {
+    bench_parse_tok(1);
+    bench_parse_tok(4);
+    bench_parse_tok(16);
+    bench_separate_args(2);
+    bench_separate_args(16);
+    bench_separate_args(100);
+    return 0;
+}
@@ -0,0 +1,68 @@
+#include "shell.h"
+#include "signal_handlers.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+// Measures how fast the shell reaps background jobs: N children are tracked in the job table and held
+// on a pipe, then released together, and the time until handle_signal_events has reaped every one
+// and emptied the table is reported. The history file is redirected to a scratch path so
+// ../data/.msh_history is left alone.
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench(int n) {
+    int gate[2];
+    if (pipe(gate) == -1) {
+        perror("pipe");
+        exit(1);
+    }
+    for (int i = 0; i < n; i++) {
+        pid_t pid = fork();
+        if (pid == 0) { // wait for the gate to close, then exit
+            char c;
+            close(gate[1]);
+            (void)!read(gate[0], &c, 1);
+            _exit(0);
+        }
+        if (pid < 0) {
+            perror("fork");
+            exit(1);
+        }
+        add_job(shell->jobs, pid, &pid, 1, BACKGROUND, "bench_reap");
+    }
+    close(gate[0]);
+
+    double start = now_sec();
+    close(gate[1]); // every child exits at once
+    while (shell->jobs->count > 0) {
+        wait_signal_events(-1);
+    }
+    double elapsed = now_sec() - start;
+    printf("bench=reap jobs=%d total_ms=%.1f reaped_per_sec=%.0f\n", n, elapsed * 1e3, n / elapsed);
+}
+
+int main() {
+    char path[] = "/tmp/msh_bench_reapXXXXXX";
+    int fd = mkstemp(path);
+    if (fd == -1) {
+        perror("mkstemp");
+        return 1;
+    }
+    close(fd);
+    HISTORY_FILE_PATH = path;
+    setenv(JOBS_GROW_ENV, "1", 1);
+
+    shell = alloc_shell(64, 0, 0);
+    if (!shell) return 1;
+    bench(100);
+    bench(1000);
+    bench(5000);
+    remove(path);
+    return 0;
+}
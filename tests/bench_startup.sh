@@ -0,0 +1,19 @@
+#! /usr/bin/env bash
+
+# Measures how long msh takes from startup to exit: runs it N times on an
+# empty script and reports the average wall time per run.
+# Usage: ./bench_startup.sh [N] [MSH]
+
+N=${1:-100}
+MSH=${2:-../bin/msh}
+
+START=$(date +%s%N)
+for ((i = 0; i < N; i++)); do
+     $MSH < /dev/null > /dev/null
+done
+END=$(date +%s%N)
+
+ELAPSED_NS=$((END - START))
+awk -v n=$N -v ns=$ELAPSED_NS 'BEGIN {
+     printf "bench=startup runs=%d total_ms=%.1f per_run_ms=%.2f\n", n, ns / 1e6, ns / 1e6 / n
+}'
@@ -0,0 +1,29 @@
+#! /usr/bin/env bash
+
+# Compares the in-process utilities (src/utilities.c) with the external
+# programs that `command NAME` runs. For each workload it runs N copies of
+# the command line through msh, both ways, and reports commands/sec.
+# Usage: ./bench_utilities.sh [N] [MSH]
+
+N=${1:-100000}
+MSH=${2:-../bin/msh}
+
+SCRIPT=$(mktemp)
+
+# run NAME PATH LINE: times N copies of LINE
+run() {
+     for ((i = 0; i < N; i++)); do echo "$3"; done > $SCRIPT
+     START=$(date +%s%N)
+     $MSH < $SCRIPT > /dev/null
+     END=$(date +%s%N)
+     awk -v w=$1 -v p=$2 -v n=$N -v ns=$((END - START)) 'BEGIN {
+          printf "bench=utilities workload=%s path=%s commands=%d total_ms=%.1f commands_per_sec=%.0f\n",
+                 w, p, n, ns / 1e6, n / (ns / 1e9)
+     }'
+}
+
+run true builtin "true"
+run true external "command true"
+run echo builtin "echo hello world"
+run echo external "command echo hello world"
+rm -f $SCRIPT
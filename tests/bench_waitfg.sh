@@ -0,0 +1,24 @@
+#! /usr/bin/env bash
+
+# Measures the per-command overhead of foreground jobs: runs N foreground
+# `/usr/bin/true` commands through msh and reports the average wall time
+# per command. Usage: ./bench_waitfg.sh [N] [MSH]
+
+N=${1:-1000}
+MSH=${2:-../bin/msh}
+
+SCRIPT=$(mktemp)
+for ((i = 0; i < N; i++)); do
+     echo "/usr/bin/true"
+done > $SCRIPT
+
+START=$(date +%s%N)
+$MSH < $SCRIPT > /dev/null
+END=$(date +%s%N)
+rm -f $SCRIPT
+
+ELAPSED_NS=$((END - START))
+awk -v n=$N -v ns=$ELAPSED_NS 'BEGIN {
+     printf "bench=waitfg commands=%d total_ms=%.1f per_command_us=%.1f commands_per_sec=%.0f\n",
+            n, ns / 1e6, ns / 1e3 / n, n / (ns / 1e9)
+}'
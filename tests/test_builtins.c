@@ -0,0 +1,71 @@
+#include "builtins.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdbool.h>
+
+// Largest seed tried when suggesting a replacement for BUILTIN_SEED
+#define SEED_SEARCH 100000
+
+// true if no two builtins share a slot under seed
+static bool seed_works(const builtin_t *registry, int count, unsigned int seed) {
+    bool used[BUILTIN_SLOTS] = {false};
+    for (int i = 0; i < count; i++) {
+        unsigned int slot = hash_builtin_name(registry[i].name, seed);
+        if (used[slot]) return false;
+        used[slot] = true;
+    }
+    return true;
+}
+
+// prints the builtin table for seed, ready to paste into src/builtins.c
+static void print_slots(const builtin_t *registry, int count, unsigned int seed) {
+    int slots[BUILTIN_SLOTS] = {0};
+    for (int i = 0; i < count; i++) slots[hash_builtin_name(registry[i].name, seed)] = i + 1;
+    printf("#define BUILTIN_SEED %u\n", seed);
+    for (int slot = 0; slot < BUILTIN_SLOTS; slot++) {
+        if (slots[slot]) printf("    [%d] = %d, // %s\n", slot, slots[slot], registry[slots[slot] - 1].name);
+    }
+}
+
+int main() {
+    int count, failed = 0;
+    const builtin_t *registry = builtin_registry(&count);
+
+    // Every builtin must be found through the compiled-in table, and only itself
+    for (int i = 0; i < count; i++) {
+        const char *name = strcmp(registry[i].name, "!") == 0 ? "!1" : registry[i].name; // a lone ! is not one
+        if (find_builtin(name) != &registry[i]) {
+            printf("\tTest %d failed: find_builtin(%s) does not return its registry entry\n", i, registry[i].name);
+            failed++;
+        }
+    }
+    if (!seed_works(registry, count, BUILTIN_SEED)) {
+        printf("\tTest %d failed: two builtins share a slot under BUILTIN_SEED %d\n", count, BUILTIN_SEED);
+        failed++;
+    }
+    const char *others[] = {"", "!", "ls", "job", "jobss", "Echo", "exit"};
+    for (int i = 0; i < (int)(sizeof(others) / sizeof(others[0])); i++) {
+        if (find_builtin(others[i]) != NULL) {
+            printf("\tTest %d failed: find_builtin(\"%s\") should be NULL\n", count + 1 + i, others[i]);
+            failed++;
+        }
+    }
+    if (!find_builtin("!12") || !find_builtin("!ec")) {
+        printf("\tTest failed: history expansions (!N, !prefix) should find the ! builtin\n");
+        failed++;
+    }
+
+    if (failed) {
+        unsigned int seed = 0;
+        while (seed < SEED_SEARCH && !seed_works(registry, count, seed)) seed++;
+        if (seed < SEED_SEARCH) {
+            printf("A builtin table that works:\n");
+            print_slots(registry, count, seed);
+        } else {
+            printf("No seed below %d works; raise BUILTIN_SLOTS\n", SEED_SEARCH);
+        }
+        return 1;
+    }
+    printf("Builtin table passed.\n");
+    return 0;
+}
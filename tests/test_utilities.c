@@ -0,0 +1,51 @@
+#include "builtins.h"
+#include "utilities.h"
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+
+static int failed = 0;
+
+// runs printf with format and one argument (or none if arg is NULL) and compares its output with expected
+void verify_printf(const char *format, const char *arg, const char *expected, size_t expected_len) {
+    static int test_num = 0;
+    char *argv[] = {"printf", (char *)format, (char *)arg, NULL};
+    char got[256];
+
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    FILE *out = tmpfile();
+    dup2(fileno(out), STDOUT_FILENO);
+    utility_printf(arg ? 3 : 2, argv);
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    rewind(out);
+    size_t got_len = fread(got, 1, sizeof(got), out);
+    fclose(out);
+
+    if (got_len != expected_len || memcmp(got, expected, expected_len) != 0) {
+        printf("\tTest %d failed: printf '%s' '%s'\n", test_num, format, arg ? arg : "(none)");
+        printf("Expected:[%.*s] (%zu bytes)\n", (int)expected_len, expected, expected_len);
+        printf("Got:[%.*s] (%zu bytes)\n", (int)got_len, got, got_len);
+        failed++;
+    } else {
+        printf("Test %d passed.\n", test_num);
+    }
+    test_num++;
+}
+
+int main() {
+    // %c prints the first character of its argument; an empty or missing one fills the field width with
+    // spaces (coreutils pads it too, but writes a NUL byte for the character itself)
+    verify_printf("[%c]", "abc", "[a]", 3);
+    verify_printf("[%3c]", "x", "[  x]", 5);
+    verify_printf("[%-3c]", "x", "[x  ]", 5);
+    verify_printf("[%c]", "", "[]", 2);
+    verify_printf("[%3c]", "", "[   ]", 5);
+    verify_printf("[%-3c]", "", "[   ]", 5);
+    verify_printf("[%3c]", NULL, "[   ]", 5);
+    verify_printf("[%3s]", "ab", "[ ab]", 5);
+    verify_printf("[%d]", "42", "[42]", 4);
+    return failed > 0;
+}